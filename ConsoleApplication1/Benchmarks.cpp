@@ -0,0 +1,658 @@
+﻿#include "Benchmarks.h"
+
+#include "ColumnKernels.h"
+#include "DataTable.h"
+#include "EncodedTable.h"
+#include "PrefetchReader.h"
+#include "SpillableTable.h"
+#include "TableIndex.h"
+#include "TableSort.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <thread>
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    template<typename T>
+    DataCell typed_cell(const wchar_t* name, SQLSMALLINT type, T v) {
+        ColumnMeta meta{ name, type, sizeof(T), 0, SQL_NULLABLE };
+        vector<BYTE> buf(sizeof(T));
+        memcpy(buf.data(), &v, sizeof(T));
+        return DataCell(move(buf), false, meta);
+    }
+
+    DataTable make_numeric_table(size_t rows) {
+        mt19937_64 rng(42);
+        uniform_int_distribution<int> ints(-1000000, 1000000);
+        DataTable table;
+        table.reserve(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            DataRow row;
+            int i = ints(rng);
+            row.emplace(L"i32", typed_cell(L"i32", SQL_INTEGER, i));
+            row.emplace(L"i64", typed_cell(L"i64", SQL_BIGINT, (long long)i * 4096));
+            row.emplace(L"f64", typed_cell(L"f64", SQL_DOUBLE, i / 3.0));
+            table.emplace_back(move(row));
+        }
+        return table;
+    }
+
+    // 重複執行直到累積至少 200ms，回傳每次的平均秒數
+    double time_it(const function<void()>& fn) {
+        using clock = chrono::steady_clock;
+        int iterations = 0;
+        auto start = clock::now();
+        chrono::duration<double> elapsed{};
+        do {
+            fn();
+            ++iterations;
+            elapsed = clock::now() - start;
+        } while (elapsed.count() < 0.2);
+        return elapsed.count() / iterations;
+    }
+
+    // bytes 為 0 時不印吞吐量
+    void report(const wchar_t* kernel, const wchar_t* path, size_t bytes, double seconds) {
+        wcout << left << setw(22) << kernel << setw(10) << path
+            << right << fixed << setprecision(3) << setw(12) << seconds * 1e3 << L" ms";
+        if (bytes) {
+            wcout << setw(10) << setprecision(2) << bytes / seconds / 1e9 << L" GB/s";
+        }
+        wcout << L'\n';
+    }
+
+    template<typename T, typename Read>
+    void bench_column(const DataTable& table, const wchar_t* column, const NumericColumn<T>& col, T threshold, Read read) {
+        const size_t bytes = col.size() * sizeof(T);
+        volatile double sink = 0;
+        wstring label = wstring(column) + L" ";
+
+        // 目前的寫法：逐列 unordered_map 查找再 get<T>()
+        report((label + L"sum").c_str(), L"per-cell", bytes, time_it([&] {
+            double s = 0;
+            for (const DataRow& row : table) s += (double)read(row.at(column));
+            sink = s;
+        }));
+        report((label + L"count_if >").c_str(), L"per-cell", bytes, time_it([&] {
+            size_t n = 0;
+            for (const DataRow& row : table) n += read(row.at(column)) > threshold;
+            sink = (double)n;
+        }));
+
+        for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::Avx2 }) {
+            force_kernel_isa(isa);
+            if (active_kernel_isa() != isa) continue;
+            const wchar_t* name = kernel_isa_name(isa);
+
+            report((label + L"sum").c_str(), name, bytes, time_it([&] { sink = (double)column_sum(col); }));
+            report((label + L"min/max").c_str(), name, bytes, time_it([&] {
+                T mn{}, mx{};
+                column_min(col, mn);
+                column_max(col, mx);
+                sink = (double)mn + (double)mx;
+            }));
+            report((label + L"count_if >").c_str(), name, bytes, time_it([&] {
+                sink = (double)column_count_if(col, CompareOp::Gt, threshold);
+            }));
+            report((label + L"filter >").c_str(), name, bytes, time_it([&] {
+                sink = (double)column_filter(col, CompareOp::Gt, threshold).size();
+            }));
+        }
+        force_kernel_isa(KernelIsa::Avx2);
+    }
+
+    int bench_kernels(size_t rows) {
+        wcout << L"Building " << rows << L" rows...\n";
+        DataTable table = make_numeric_table(rows);
+
+        auto start = chrono::steady_clock::now();
+        Int32Column i32 = extract_int32(table, L"i32");
+        Int64Column i64 = extract_int64(table, L"i64");
+        DoubleColumn f64 = extract_double(table, L"f64");
+        chrono::duration<double> extract = chrono::steady_clock::now() - start;
+        wcout << L"Column extraction (3 columns): " << fixed << setprecision(3) << extract.count() * 1e3 << L" ms\n\n";
+
+        bench_column(table, L"i32", i32, 0, [](const DataCell& c) { return c.get<int>(); });
+        bench_column(table, L"i64", i64, (int64_t)0, [](const DataCell& c) { return (int64_t)c.get<long long>(); });
+        bench_column(table, L"f64", f64, 0.0, [](const DataCell& c) { return c.get<double>(); });
+        return 0;
+    }
+
+    DataCell wide_cell(const wchar_t* name, const wstring& text) {
+        ColumnMeta meta{ name, SQL_WVARCHAR, 4000, 0, SQL_NULLABLE };
+        const BYTE* p = (const BYTE*)text.data();
+        return DataCell(vector<BYTE>(p, p + text.size() * sizeof(wchar_t)), false, meta);
+    }
+
+    // 模擬 command() 取回的寬文字結果：以 ASCII 為主，約 1/8 的 message 含中文
+    DataTable make_text_table(size_t rows) {
+        static const wchar_t* words[] = { L"connection", L"timeout", L"retry", L"query", L"commit", L"user", L"login", L"failed" };
+        static const wchar_t* levels[] = { L"INFO", L"WARN", L"ERROR", L"DEBUG" };
+        mt19937_64 rng(7);
+        DataTable table;
+        table.reserve(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            wstring message;
+            int n = 20 + (int)(rng() % 20);
+            for (int w = 0; w < n; ++w) {
+                message += words[rng() % 8];
+                message += L' ';
+            }
+            if (rng() % 8 == 0) {
+                message += L"資料庫連線逾時";
+            }
+
+            DataRow row;
+            row.emplace(L"host", wide_cell(L"host", L"srv-" + to_wstring(rng() % 64) + L".corp.local"));
+            row.emplace(L"level", wide_cell(L"level", levels[rng() % 4]));
+            row.emplace(L"source", wide_cell(L"source", L"Microsoft-Windows-Security-Auditing"));
+            row.emplace(L"path", wide_cell(L"path", L"C:\\Windows\\System32\\winevt\\Logs\\app-" + to_wstring(rng() % 1000) + L".evtx"));
+            row.emplace(L"message", wide_cell(L"message", message));
+            table.emplace_back(move(row));
+        }
+        return table;
+    }
+
+    int bench_utf8(size_t rows) {
+        wcout << L"Building " << rows << L" rows...\n";
+        DataTable wide = make_text_table(rows);
+
+        size_t wide_bytes = memory_usage(wide).total();
+        size_t wide_payload = 0;
+        vector<wstring_view> wide_texts;
+        for (const DataRow& row : wide) {
+            for (const auto& kv : row) {
+                wide_payload += kv.second.buffer.size();
+                wide_texts.emplace_back((const wchar_t*)kv.second.buffer.data(), kv.second.buffer.size() / sizeof(wchar_t));
+            }
+        }
+
+        Utf8Table narrow = to_utf8_table(wide);
+        size_t narrow_bytes = memory_usage(narrow).total();
+        size_t narrow_payload = 0;
+        vector<string_view> narrow_texts;
+        for (const Utf8Row& row : narrow) {
+            for (const auto& kv : row) {
+                narrow_payload += kv.second.data.size();
+                narrow_texts.push_back(kv.second.text());
+            }
+        }
+
+        wcout << fixed << setprecision(1)
+            << L"DataTable (UTF-16):  " << setw(8) << wide_bytes / 1048576.0 << L" MB, text payload "
+            << wide_payload / 1048576.0 << L" MB\n"
+            << L"Utf8Table (UTF-8):   " << setw(8) << narrow_bytes / 1048576.0 << L" MB, text payload "
+            << narrow_payload / 1048576.0 << L" MB\n\n";
+
+        volatile size_t sink = 0;
+        for (KernelIsa isa : { KernelIsa::Scalar, KernelIsa::Avx2 }) {
+            force_kernel_isa(isa);
+            if (active_kernel_isa() != isa) continue;
+            const wchar_t* name = kernel_isa_name(isa);
+
+            string utf8;
+            report(L"utf16 -> utf8", name, wide_payload, time_it([&] {
+                size_t n = 0;
+                for (wstring_view s : wide_texts) {
+                    utf8.clear();
+                    wide_to_utf8(s, utf8);
+                    n += utf8.size();
+                }
+                sink = n;
+            }));
+
+            wstring utf16;
+            report(L"utf8 -> utf16", name, narrow_payload, time_it([&] {
+                size_t n = 0;
+                for (string_view s : narrow_texts) {
+                    utf16.clear();
+                    utf8_to_wide(s, utf16);
+                    n += utf16.size();
+                }
+                sink = n;
+            }));
+        }
+        force_kernel_isa(KernelIsa::Avx2);
+
+        // 逐格取出文字：DataCell::to_string() 每次都複製，Utf8Cell::text() 直接回傳 view
+        report(L"read text", L"wstring", wide_payload, time_it([&] {
+            size_t n = 0;
+            for (const DataRow& row : wide) {
+                for (const auto& kv : row) n += kv.second.to_string().size();
+            }
+            sink = n;
+        }));
+        report(L"read text", L"utf8", narrow_payload, time_it([&] {
+            size_t n = 0;
+            for (const Utf8Row& row : narrow) {
+                for (const auto& kv : row) n += kv.second.text().size();
+            }
+            sink = n;
+        }));
+        report(L"read text", L"view", wide_payload, time_it([&] {
+            size_t n = 0;
+            for (const DataRow& row : wide) {
+                for (const auto& kv : row) n += kv.second.text().size();
+            }
+            sink = n;
+        }));
+        return 0;
+    }
+
+    void report_memory(const wchar_t* label, const MemoryUsage& usage) {
+        wcout << left << setw(22) << label << right << fixed << setprecision(1)
+            << setw(9) << usage.total() / 1048576.0 << L" MB  (payload " << usage.payload / 1048576.0
+            << L", metadata " << usage.metadata / 1048576.0 << L", overhead " << usage.overhead / 1048576.0 << L")\n";
+    }
+
+    // 模擬事件查詢結果：來源、關鍵字、工作類別只有數百種值，內容幾乎每列不同
+    int bench_dictionary(size_t rows) {
+        wcout << L"Building " << rows << L" rows...\n";
+        mt19937_64 rng(11);
+        DataTable table;
+        table.reserve(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            DataRow row;
+            row.emplace(L"來源", wide_cell(L"來源", L"Microsoft-Windows-Provider-" + to_wstring(rng() % 300)));
+            row.emplace(L"關鍵字", wide_cell(L"關鍵字", L"Audit Success, Classic " + to_wstring(rng() % 16)));
+            row.emplace(L"工作類別", wide_cell(L"工作類別", L"Task Category " + to_wstring(rng() % 100)));
+            row.emplace(L"內容", wide_cell(L"內容", L"Event message " + to_wstring(rng())));
+            row.emplace(L"事件識別碼", typed_cell(L"事件識別碼", SQL_INTEGER, (int)(rng() % 5000)));
+            table.emplace_back(move(row));
+        }
+
+        auto start = chrono::steady_clock::now();
+        EncodedTable encoded;
+        for (const DataRow& row : table) {
+            encoded.append(DataRow(row));
+        }
+        chrono::duration<double> encode = chrono::steady_clock::now() - start;
+
+        wcout << L"Encoded columns:";
+        for (const wstring& name : encoded.encoded_columns()) {
+            wcout << L' ' << name << L'(' << encoded.dictionary(name)->distinct() << L')';
+        }
+        wcout << L"\nEncoding (incl. row copy): " << fixed << setprecision(1) << encode.count() * 1e3 << L" ms\n\n";
+
+        report_memory(L"DataTable", memory_usage(table));
+        report_memory(L"EncodedTable", encoded.memory_usage());
+
+        // 只看被編碼的欄：同樣幾欄的 DataTable 對上 dictionary 與 code
+        DataTable projected;
+        projected.reserve(table.size());
+        MemoryUsage dictionaries;
+        for (const wstring& name : encoded.encoded_columns()) {
+            dictionaries += encoded.dictionary(name)->memory_usage();
+        }
+        for (const DataRow& row : table) {
+            DataRow out;
+            for (const wstring& name : encoded.encoded_columns()) {
+                out.emplace(name, row.at(name));
+            }
+            projected.emplace_back(move(out));
+        }
+        report_memory(L"  encoded cols, cells", memory_usage(projected));
+        report_memory(L"  encoded cols, codes", dictionaries);
+        wcout << L'\n';
+
+        const wstring provider = L"Microsoft-Windows-Provider-42";
+        volatile size_t sink = 0;
+        report(L"filter 來源 =", L"cells", 0, time_it([&] {
+            size_t n = 0;
+            for (const DataRow& row : table) {
+                const DataCell& c = row.at(L"來源");
+                n += wstring_view((const wchar_t*)c.buffer.data(), c.buffer.size() / sizeof(wchar_t)) == provider;
+            }
+            sink = n;
+        }));
+        report(L"filter 來源 =", L"codes", 0, time_it([&] {
+            sink = encoded.filter_equal(L"來源", provider).size();
+        }));
+
+        vector<Aggregate> count{ { AggregateKind::Count, L"", L"n" } };
+        report(L"group by 來源,工作類別", L"cells", 0, time_it([&] {
+            sink = group_by(table, { L"來源", L"工作類別" }, count).size();
+        }));
+        report(L"group by 來源,工作類別", L"codes", 0, time_it([&] {
+            sink = group_by(encoded, { L"來源", L"工作類別" }, count).size();
+        }));
+        return 0;
+    }
+
+    // 報表原本的寫法：逐次比較兩列的 to_string()，對上型別化的 sort_table() 與 top_k()
+    int bench_sort(size_t rows) {
+        wcout << L"Building " << rows << L" rows...\n";
+        mt19937_64 rng(5);
+        DataTable table;
+        table.reserve(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            DataRow row;
+            row.emplace(L"level", typed_cell(L"level", SQL_INTEGER, (int)(rng() % 5)));
+            row.emplace(L"host", wide_cell(L"host", L"srv-" + to_wstring(rng() % 512)));
+            row.emplace(L"elapsed", typed_cell(L"elapsed", SQL_DOUBLE, (rng() % 1000000) / 1000.0));
+            table.emplace_back(move(row));
+        }
+        const vector<SortKey> keys{ { L"level", true }, { L"host" }, { L"elapsed", true } };
+        wcout << L"ORDER BY level DESC, host, elapsed DESC; " << thread::hardware_concurrency() << L" hardware threads\n\n";
+
+        using clock = chrono::steady_clock;
+        auto run = [&](const wchar_t* label, const function<void(DataTable&)>& fn) {
+            DataTable copy = table;
+            auto start = clock::now();
+            fn(copy);
+            chrono::duration<double> elapsed = clock::now() - start;
+            report(label, L"", 0, elapsed.count());
+        };
+
+        run(L"sort by to_string()", [](DataTable& t) {
+            sort(t.begin(), t.end(), [](const DataRow& a, const DataRow& b) {
+                if (int c = b.at(L"level").to_string().compare(a.at(L"level").to_string())) return c < 0;
+                if (int c = a.at(L"host").to_string().compare(b.at(L"host").to_string())) return c < 0;
+                return b.at(L"elapsed").to_string() < a.at(L"elapsed").to_string();
+            });
+        });
+        run(L"sort_table", [&](DataTable& t) { sort_table(t, keys); });
+        run(L"top_k 100", [&](DataTable& t) { volatile size_t n = top_k_order(t, keys, 100).size(); (void)n; });
+        return 0;
+    }
+
+    // 模擬畫面表格：每次重繪把可見的 visible_rows 列全部格式化一次，捲動時視窗往下移一列
+    int bench_cells(size_t rows) {
+        const size_t visible_rows = 40;
+        const size_t repaints = 200;
+
+        mt19937_64 rng(9);
+        DataTable table;
+        table.reserve(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            DataRow row;
+            SQL_NUMERIC_STRUCT amount{};
+            amount.precision = 18;
+            amount.scale = 2;
+            amount.sign = 1;
+            unsigned long long cents = rng() % 100000000;
+            memcpy(amount.val, &cents, sizeof(cents));
+            TIMESTAMP_STRUCT ts{ 2024, (SQLUSMALLINT)(1 + rng() % 12), (SQLUSMALLINT)(1 + rng() % 28),
+                (SQLUSMALLINT)(rng() % 24), (SQLUSMALLINT)(rng() % 60), (SQLUSMALLINT)(rng() % 60), 0 };
+
+            row.emplace(L"id", typed_cell(L"id", SQL_BIGINT, (long long)r));
+            row.emplace(L"host", wide_cell(L"host", L"srv-" + to_wstring(rng() % 512) + L".corp.local"));
+            row.emplace(L"amount", DataCell(vector<BYTE>((const BYTE*)&amount, (const BYTE*)(&amount + 1)), false,
+                ColumnMeta{ L"amount", SQL_DECIMAL, 18, 2, SQL_NULLABLE }));
+            row.emplace(L"time", typed_cell(L"time", SQL_TYPE_TIMESTAMP, ts));
+            row.emplace(L"ratio", typed_cell(L"ratio", SQL_DOUBLE, (rng() % 10000) / 100.0));
+            table.emplace_back(move(row));
+        }
+        wcout << rows << L" rows, " << visible_rows << L" visible rows, " << repaints << L" repaints\n\n";
+
+        volatile size_t sink = 0;
+        auto paint = [&](auto&& render) {
+            size_t n = 0;
+            for (size_t frame = 0; frame < repaints; ++frame) {
+                size_t top = frame % max<size_t>(rows - min(rows, visible_rows), 1);
+                for (size_t r = top; r < min(rows, top + visible_rows); ++r) {
+                    for (const auto& kv : table[r]) n += render(r, kv.first, kv.second);
+                }
+            }
+            sink = n;
+        };
+        report(L"repaint", L"to_string", 0, time_it([&] {
+            paint([](size_t, const wstring&, const DataCell& c) { return c.to_string().size(); });
+        }));
+        FormattedCache cache;
+        report(L"repaint", L"cached", 0, time_it([&] {
+            paint([&](size_t r, const wstring& column, const DataCell&) { return cache.get(table, r, column).size(); });
+        }));
+
+        // NUMERIC 轉數值：原本要先 to_string() 再解析，get<double>() 直接從 SQL_NUMERIC_STRUCT 換算
+        report(L"sum amount", L"via text", 0, time_it([&] {
+            double total = 0;
+            for (const DataRow& row : table) total += stod(row.at(L"amount").to_string());
+            sink = (size_t)total;
+        }));
+        report(L"sum amount", L"get<T>", 0, time_it([&] {
+            double total = 0;
+            for (const DataRow& row : table) total += row.at(L"amount").get<double>();
+            sink = (size_t)total;
+        }));
+        return 0;
+    }
+
+    // DECIMAL(precision, scale)，絕對值為 hi * 2^64 + lo
+    DataCell numeric_cell(SQLCHAR precision, SQLSCHAR scale, bool negative, unsigned long long lo, unsigned long long hi = 0) {
+        SQL_NUMERIC_STRUCT n{};
+        n.precision = precision;
+        n.scale = scale;
+        n.sign = negative ? 0 : 1;
+        memcpy(n.val, &lo, sizeof(lo));
+        memcpy(n.val + 8, &hi, sizeof(hi));
+        return DataCell(vector<BYTE>((const BYTE*)&n, (const BYTE*)(&n + 1)), false,
+            ColumnMeta{ L"", SQL_DECIMAL, precision, scale, SQL_NULLABLE });
+    }
+
+    // compare_cells() == 0 的兩個 cell 雜湊必須相同，HashIndex / hash_join / group_by 才不會漏掉相符的列
+    bool check_numeric_hash() {
+        struct Case {
+            const wchar_t* label;
+            DataCell a, b;
+            bool equal;
+        };
+        const vector<Case> cases{
+            { L"DECIMAL(38,2) vs BIGINT above 2^53", numeric_cell(38, 2, false, 900719925474099300ull),
+              typed_cell(L"", SQL_BIGINT, 9007199254740993LL), true },
+            { L"DECIMAL scale 0 vs scale 4", numeric_cell(38, 0, false, 9007199254740993ull),
+              numeric_cell(38, 4, false, 16285016252571723536ull, 4), true },
+            { L"DECIMAL 0.50 vs DOUBLE 0.5", numeric_cell(10, 2, false, 50), typed_cell(L"", SQL_DOUBLE, 0.5), true },
+            { L"DECIMAL 0.1 vs DOUBLE 0.1", numeric_cell(10, 1, false, 1), typed_cell(L"", SQL_DOUBLE, 0.1), false },
+            { L"DOUBLE 2^53 vs BIGINT 2^53+1", typed_cell(L"", SQL_DOUBLE, 9007199254740992.0),
+              typed_cell(L"", SQL_BIGINT, 9007199254740993LL), false },
+            { L"DECIMAL 2^64 vs DOUBLE 2^64", numeric_cell(38, 0, false, 0, 1), typed_cell(L"", SQL_DOUBLE, 0x1p64), true },
+            { L"DECIMAL -1.25 vs REAL -1.25", numeric_cell(10, 2, true, 125), typed_cell(L"", SQL_REAL, -1.25f), true },
+            { L"DECIMAL 1.5 vs INTEGER 1", numeric_cell(10, 1, false, 15), typed_cell(L"", SQL_INTEGER, 1), false },
+        };
+
+        bool ok = true;
+        vector<const DataCell*> all;
+        for (const Case& c : cases) {
+            bool equal = compare_cells(c.a, c.b) == 0;
+            bool pass = equal == c.equal && (!equal || hash_cell(c.a) == hash_cell(c.b));
+            wcout << left << setw(40) << c.label << (pass ? L"ok" : L"FAILED") << L'\n';
+            ok = ok && pass;
+            all.push_back(&c.a);
+            all.push_back(&c.b);
+        }
+        // 所有組合都要反對稱，相等時雜湊相同
+        size_t violations = 0;
+        for (const DataCell* x : all) {
+            for (const DataCell* y : all) {
+                int c = compare_cells(*x, *y);
+                if (c != -compare_cells(*y, *x) || (c == 0 && hash_cell(*x) != hash_cell(*y))) ++violations;
+            }
+        }
+        wcout << left << setw(40) << L"all pairs" << (violations ? L"FAILED" : L"ok") << L'\n';
+        return ok && violations == 0;
+    }
+
+    // sort_order() / top_k_order() 對照以 compare_cells() 做的 stable_sort：每種欄位組合、方向與 NULL 位置都要完全相同
+    // 包含 NaN、超過 2^53 的整數、DATE / TIME 與整數混在同一欄等型別化路徑要退回 compare_cells() 的情況
+    bool check_sort(size_t rows) {
+        mt19937_64 rng(11);
+        auto null_cell = [](SQLSMALLINT type) { return DataCell(vector<BYTE>(), true, ColumnMeta{ L"", type, 0, 0, SQL_NULLABLE }); };
+        DataTable table;
+        table.reserve(rows);
+        for (size_t r = 0; r < rows; ++r) {
+            DataRow row;
+            row.emplace(L"int", rng() % 13 ? typed_cell(L"int", SQL_INTEGER, (int)(rng() % 10)) : null_cell(SQL_INTEGER));
+            double real = rng() % 17 ? (double)(rng() % 1000) / 8 : numeric_limits<double>::quiet_NaN();
+            row.emplace(L"real", typed_cell(L"real", SQL_DOUBLE, real));
+            row.emplace(L"mixed", rng() % 2 ? typed_cell(L"mixed", SQL_BIGINT, (long long)(rng() % 50))
+                                            : typed_cell(L"mixed", SQL_DOUBLE, (rng() % 500) / 10.0));
+            row.emplace(L"wide", rng() % 2 ? typed_cell(L"wide", SQL_BIGINT, (1LL << 53) + (long long)(rng() % 8))
+                                           : typed_cell(L"wide", SQL_DOUBLE, 0x1p53 + (double)(rng() % 4) * 2));
+            if (rng() % 11) {
+                row.emplace(L"text", wide_cell(L"text", L"h" + to_wstring(rng() % 30)));
+            }
+            TIMESTAMP_STRUCT ts{ (SQLSMALLINT)(2020 + rng() % 3), (SQLUSMALLINT)(1 + rng() % 12), (SQLUSMALLINT)(1 + rng() % 28),
+                (SQLUSMALLINT)(rng() % 24), 0, 0, (SQLUINTEGER)(rng() % 3) };
+            row.emplace(L"stamp", typed_cell(L"stamp", SQL_TYPE_TIMESTAMP, ts));
+            switch (rng() % 3) {
+            case 0: row.emplace(L"dates", typed_cell(L"dates", SQL_TYPE_DATE, DATE_STRUCT{ 2024, 1, (SQLUSMALLINT)(1 + rng() % 28) })); break;
+            case 1: row.emplace(L"dates", typed_cell(L"dates", SQL_TYPE_TIME, TIME_STRUCT{ (SQLUSMALLINT)(rng() % 24), 0, 0 })); break;
+            default: row.emplace(L"dates", typed_cell(L"dates", SQL_INTEGER, (int)(rng() % 40000))); break;
+            }
+            row.emplace(L"decimal", rng() % 2 ? numeric_cell(10, 2, rng() % 4 == 0, rng() % 5000)
+                                              : typed_cell(L"decimal", SQL_INTEGER, (int)(rng() % 50)));
+            table.emplace_back(move(row));
+        }
+
+        auto reference = [&](const vector<SortKey>& keys) {
+            vector<size_t> order(rows);
+            iota(order.begin(), order.end(), size_t(0));
+            stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+                for (const SortKey& k : keys) {
+                    auto ia = table[a].find(k.column);
+                    auto ib = table[b].find(k.column);
+                    bool na = ia == table[a].end() || ia->second.is_null();
+                    bool nb = ib == table[b].end() || ib->second.is_null();
+                    if (na || nb) {
+                        if (na && nb) continue;
+                        bool nulls_first = k.nulls == NullOrder::Default ? !k.descending : k.nulls == NullOrder::First;
+                        return na == nulls_first;
+                    }
+                    int c = compare_cells(ia->second, ib->second);
+                    if (k.descending) c = -c;
+                    if (c) return c < 0;
+                }
+                return false;
+            });
+            return order;
+        };
+
+        vector<vector<SortKey>> key_sets;
+        for (const wchar_t* column : { L"int", L"real", L"mixed", L"wide", L"text", L"stamp", L"dates", L"decimal" }) {
+            for (bool descending : { false, true }) {
+                for (NullOrder nulls : { NullOrder::Default, NullOrder::First, NullOrder::Last }) {
+                    key_sets.push_back({ { column, descending, nulls } });
+                }
+            }
+        }
+        key_sets.push_back({ { L"int", true }, { L"text" }, { L"real", true } });
+        key_sets.push_back({ { L"dates" }, { L"decimal", true, NullOrder::Last } });
+
+        size_t failed = 0;
+        for (const auto& keys : key_sets) {
+            vector<size_t> expected = reference(keys);
+            vector<size_t> top = top_k_order(table, keys, 50);
+            if (sort_order(table, keys) != expected || !equal(top.begin(), top.end(), expected.begin())) {
+                if (failed++ == 0) {
+                    wcout << L"  first mismatch: ORDER BY " << keys.front().column << (keys.front().descending ? L" DESC" : L"") << L'\n';
+                }
+            }
+        }
+        wstring label = L"sort_order vs reference, " + to_wstring(rows) + L" rows";
+        wcout << left << setw(40) << label << (failed ? L"FAILED" : L"ok") << L" (" << key_sets.size() << L" orders)\n";
+        return failed == 0;
+    }
+
+    // 不量時間，只驗證；有任何一項失敗時回傳 1
+    int run_checks() {
+        bool ok = check_numeric_hash();
+        // 超過 parallel_sort_threshold 才會走平行抽取與排序
+        for (size_t rows : { (size_t)1000, parallel_sort_threshold + 5000 }) {
+            ok = check_sort(rows) && ok;
+        }
+        return ok ? 0 : 1;
+    }
+
+    // 以忙等模擬消費端的 CPU 工作
+    void spin_for(chrono::nanoseconds d) {
+        auto until = chrono::steady_clock::now() + d;
+        while (chrono::steady_clock::now() < until) {
+        }
+    }
+
+    // 模擬遠端 SQL Server：每取 fetch_rows 列在 driver 裡等一次 round trip（不佔 CPU）；消費端每列做固定的處理
+    // round trip 用 sleep，Windows 的計時器精度會把它放大到約 15.6ms，兩種讀法受到的影響相同
+    int bench_prefetch(size_t rows) {
+        const size_t fetch_rows = 256;
+        const auto round_trip = chrono::milliseconds(2);
+        const auto per_row_work = chrono::nanoseconds(2000000 / fetch_rows);
+
+        auto producer = [&](const function<void(DataRow&&)>& sink, CancellationToken&) {
+            for (size_t r = 0; r < rows; ++r) {
+                if (r % fetch_rows == 0) this_thread::sleep_for(round_trip);
+                DataRow row;
+                row.emplace(L"id", typed_cell(L"id", SQL_BIGINT, (long long)r));
+                row.emplace(L"value", typed_cell(L"value", SQL_DOUBLE, r / 7.0));
+                sink(move(row));
+            }
+        };
+        volatile double total = 0;
+        auto consume = [&](const DataRow& row) {
+            spin_for(per_row_work);
+            total = total + row.at(L"value").get<double>();
+        };
+
+        wcout << rows << L" rows, " << fetch_rows << L" rows per round trip, "
+            << round_trip.count() << L" ms per round trip, " << per_row_work.count() << L" ns work per row\n\n";
+
+        auto start = chrono::steady_clock::now();
+        CancellationToken unused;
+        producer([&](DataRow&& row) { consume(row); }, unused);
+        chrono::duration<double> serial = chrono::steady_clock::now() - start;
+        wcout << left << setw(22) << L"serial" << right << fixed << setprecision(1)
+            << setw(10) << serial.count() * 1e3 << L" ms\n";
+
+        for (size_t depth : { 2, 4 }) {
+            for (size_t block_rows : { 256, 4096 }) {
+                PrefetchReader reader(producer, PrefetchOptions{ block_rows, depth });
+                reader.for_each(consume);
+                PrefetchStats stats = reader.stats();
+                wstring label = L"prefetch " + to_wstring(depth) + L"x" + to_wstring(block_rows);
+                wcout << left << setw(22) << label << right << fixed << setprecision(1)
+                    << setw(10) << stats.wall_seconds * 1e3 << L" ms"
+                    << L"  consumer stall " << setw(7) << stats.consumer_stall_seconds * 1e3 << L" ms"
+                    << L"  producer stall " << setw(7) << stats.producer_stall_seconds * 1e3 << L" ms\n";
+            }
+        }
+        return 0;
+    }
+}
+
+int SaoFU::run_benchmark(const wstring& name, size_t rows) {
+    if (name == L"kernels") {
+        return bench_kernels(rows ? rows : 200000);
+    }
+    if (name == L"utf8") {
+        return bench_utf8(rows ? rows : 200000);
+    }
+    if (name == L"dictionary") {
+        return bench_dictionary(rows ? rows : 200000);
+    }
+    if (name == L"sort") {
+        return bench_sort(rows ? rows : 200000);
+    }
+    if (name == L"prefetch") {
+        return bench_prefetch(rows ? rows : 100000);
+    }
+    if (name == L"cells") {
+        return bench_cells(rows ? rows : 100000);
+    }
+    if (name == L"check") {
+        return run_checks();
+    }
+
+    wcerr << L"Unknown benchmark: " << name << L"\nAvailable: kernels, utf8, dictionary, sort, prefetch, cells, check\n";
+    return 1;
+}
@@ -0,0 +1,14 @@
+﻿// Benchmarks.h
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+
+namespace SaoFU {
+    // 以合成資料量測，不需要資料庫連線；由 main 的 --bench <name> [rows] 呼叫
+    // --bench check 不量時間，只跑雜湊與排序的對照檢查
+    // 回傳值作為 process exit code
+    int run_benchmark(const std::wstring& name, std::size_t rows);
+}
+
+#endif // BENCHMARKS_H
@@ -0,0 +1,34 @@
+﻿#include "CancellationToken.h"
+
+using namespace SaoFU;
+using namespace std;
+
+void CancellationToken::cancel() {
+    lock_guard<std::mutex> lock(mutex);
+    cancelled = true;
+    if (active) {
+        SQLCancel(active);
+    }
+}
+
+bool CancellationToken::is_cancelled() const noexcept {
+    return cancelled;
+}
+
+void CancellationToken::reset() noexcept {
+    cancelled = false;
+}
+
+bool CancellationToken::attach(SQLHSTMT h_stmt) {
+    lock_guard<std::mutex> lock(mutex);
+    if (cancelled) {
+        return false;
+    }
+    active = h_stmt;
+    return true;
+}
+
+void CancellationToken::detach() noexcept {
+    lock_guard<std::mutex> lock(mutex);
+    active = nullptr;
+}
@@ -0,0 +1,28 @@
+﻿// CancellationToken.h
+#ifndef CANCELLATION_TOKEN_H
+#define CANCELLATION_TOKEN_H
+#define NOMINMAX
+#include <windows.h>
+#include <sqlext.h>
+#include <atomic>
+#include <mutex>
+
+namespace SaoFU {
+    // 由其他執行緒呼叫 cancel()，對目前正在執行的 statement 發出 SQLCancel
+    // 一個 token 同一時間只追蹤一個 statement
+    class CancellationToken {
+        std::mutex mutex;
+        SQLHSTMT active = nullptr;
+        std::atomic<bool> cancelled{ false };
+    public:
+        void cancel();
+        bool is_cancelled() const noexcept;
+        void reset() noexcept;
+
+        // 供 DatabaseAccess 使用；已取消時回傳 false
+        bool attach(SQLHSTMT h_stmt);
+        void detach() noexcept;
+    };
+}
+
+#endif // CANCELLATION_TOKEN_H
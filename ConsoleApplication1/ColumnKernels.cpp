@@ -0,0 +1,507 @@
+﻿#include "ColumnKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cstring>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SAOFU_X86_KERNELS 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SAOFU_AVX2_TARGET
+#else
+#define SAOFU_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define SAOFU_X86_KERNELS 0
+#endif
+
+using namespace SaoFU;
+using namespace std;
+
+// ---------- 欄位抽取 ----------
+
+template<typename T, typename Convert>
+static NumericColumn<T> extract_column(const DataTable& table, const wstring& column, Convert convert) {
+    NumericColumn<T> col;
+    col.values.reserve(table.size());
+    col.validity.reserve(table.size() / 64 + 1);
+
+    for (const DataRow& row : table) {
+        auto it = row.find(column);
+        T v{};
+        bool valid = it != row.end() && convert(it->second, v);
+        col.push_back(v, valid);
+    }
+    return col;
+}
+
+Int32Column SaoFU::extract_int32(const DataTable& table, const wstring& column) {
+    return extract_column<int32_t>(table, column, [](const DataCell& c, int32_t& out) {
+        long long v;
+        if (c.meta.data_type == SQL_BIGINT || !cell_to_int64(c, v)) return false;
+        out = (int32_t)v;
+        return true;
+    });
+}
+
+Int64Column SaoFU::extract_int64(const DataTable& table, const wstring& column) {
+    return extract_column<int64_t>(table, column, [](const DataCell& c, int64_t& out) {
+        long long v;
+        if (!cell_to_int64(c, v)) return false;
+        out = v;
+        return true;
+    });
+}
+
+DoubleColumn SaoFU::extract_double(const DataTable& table, const wstring& column) {
+    return extract_column<double>(table, column, [](const DataCell& c, double& out) {
+        return cell_to_double(c, out);
+    });
+}
+
+// ---------- 純量版本 ----------
+
+namespace {
+    template<typename T>
+    bool compare_scalar(T v, CompareOp op, T rhs) {
+        switch (op) {
+        case CompareOp::Eq: return v == rhs;
+        case CompareOp::Ne: return v != rhs;
+        case CompareOp::Lt: return v < rhs;
+        case CompareOp::Le: return v <= rhs;
+        case CompareOp::Gt: return v > rhs;
+        case CompareOp::Ge: return v >= rhs;
+        }
+        return false;
+    }
+
+    inline bool bit_at(const uint64_t* validity, size_t i) {
+        return (validity[i >> 6] >> (i & 63)) & 1;
+    }
+
+    template<typename T>
+    typename ColumnSumType<T>::type scalar_sum(const T* v, size_t begin, size_t end) {
+        typename ColumnSumType<T>::type s = 0;
+        for (size_t i = begin; i < end; ++i) {
+            s += v[i];
+        }
+        return s;
+    }
+
+    // NaN 與 NULL 一樣略過
+    template<typename T>
+    void scalar_min_max(const T* v, const uint64_t* validity, size_t begin, size_t end, T& mn, T& mx, bool& any) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!bit_at(validity, i) || v[i] != v[i]) continue;
+            if (!any) {
+                mn = mx = v[i];
+                any = true;
+                continue;
+            }
+            if (v[i] < mn) mn = v[i];
+            if (v[i] > mx) mx = v[i];
+        }
+    }
+
+    template<typename T>
+    size_t scalar_filter(const T* v, const uint64_t* validity, size_t begin, size_t end, CompareOp op, T rhs, uint32_t* out) {
+        size_t n = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if (bit_at(validity, i) && compare_scalar(v[i], op, rhs)) {
+                if (out) out[n] = (uint32_t)i;
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    inline int count_trailing_zeros(uint32_t m) {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, m);
+        return (int)idx;
+#else
+        return __builtin_ctz(m);
+#endif
+    }
+
+    // 把 compare mask 與 validity 交集後的 bit 展開成列號
+    inline size_t emit_selection(uint32_t mask, size_t base, uint32_t* out) {
+        if (!out) {
+            return bitset<32>(mask).count();
+        }
+        size_t n = 0;
+        while (mask) {
+            out[n++] = (uint32_t)(base + count_trailing_zeros(mask));
+            mask &= mask - 1;
+        }
+        return n;
+    }
+
+    // validity 以 byte 讀取：x86 為 little-endian，第 i 列在 byte i/8 的第 i%8 bit
+    inline uint32_t validity_bits(const uint64_t* validity, size_t i, int width) {
+        const uint8_t* bytes = (const uint8_t*)validity;
+        uint32_t b = bytes[i >> 3] >> (i & 7);
+        return b & ((1u << width) - 1);
+    }
+}
+
+// ---------- AVX2 版本 ----------
+
+#if SAOFU_X86_KERNELS
+namespace {
+    SAOFU_AVX2_TARGET inline __m256i not_si256(__m256i v) {
+        return _mm256_xor_si256(v, _mm256_set1_epi32(-1));
+    }
+
+    SAOFU_AVX2_TARGET inline __m256i compare_epi32(__m256i v, __m256i k, CompareOp op) {
+        switch (op) {
+        case CompareOp::Eq: return _mm256_cmpeq_epi32(v, k);
+        case CompareOp::Ne: return not_si256(_mm256_cmpeq_epi32(v, k));
+        case CompareOp::Lt: return _mm256_cmpgt_epi32(k, v);
+        case CompareOp::Le: return not_si256(_mm256_cmpgt_epi32(v, k));
+        case CompareOp::Gt: return _mm256_cmpgt_epi32(v, k);
+        default:            return not_si256(_mm256_cmpgt_epi32(k, v));
+        }
+    }
+
+    SAOFU_AVX2_TARGET inline __m256i compare_epi64(__m256i v, __m256i k, CompareOp op) {
+        switch (op) {
+        case CompareOp::Eq: return _mm256_cmpeq_epi64(v, k);
+        case CompareOp::Ne: return not_si256(_mm256_cmpeq_epi64(v, k));
+        case CompareOp::Lt: return _mm256_cmpgt_epi64(k, v);
+        case CompareOp::Le: return not_si256(_mm256_cmpgt_epi64(v, k));
+        case CompareOp::Gt: return _mm256_cmpgt_epi64(v, k);
+        default:            return not_si256(_mm256_cmpgt_epi64(k, v));
+        }
+    }
+
+    SAOFU_AVX2_TARGET inline __m256d compare_pd(__m256d v, __m256d k, CompareOp op) {
+        switch (op) {
+        case CompareOp::Eq: return _mm256_cmp_pd(v, k, _CMP_EQ_OQ);
+        case CompareOp::Ne: return _mm256_cmp_pd(v, k, _CMP_NEQ_UQ);
+        case CompareOp::Lt: return _mm256_cmp_pd(v, k, _CMP_LT_OQ);
+        case CompareOp::Le: return _mm256_cmp_pd(v, k, _CMP_LE_OQ);
+        case CompareOp::Gt: return _mm256_cmp_pd(v, k, _CMP_GT_OQ);
+        default:            return _mm256_cmp_pd(v, k, _CMP_GE_OQ);
+        }
+    }
+
+    // 8 個 validity bit 展開成 8 個 32-bit lane mask
+    SAOFU_AVX2_TARGET inline __m256i lane_mask_epi32(uint32_t bits) {
+        const __m256i sel = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), sel), sel);
+    }
+
+    SAOFU_AVX2_TARGET inline __m256i lane_mask_epi64(uint32_t bits) {
+        const __m256i sel = _mm256_setr_epi64x(1, 2, 4, 8);
+        return _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(bits), sel), sel);
+    }
+
+    SAOFU_AVX2_TARGET int64_t avx2_sum_i32(const int32_t* v, size_t n) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+            acc0 = _mm256_add_epi64(acc0, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+            acc1 = _mm256_add_epi64(acc1, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+        }
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(acc0, acc1));
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar_sum(v, i, n);
+    }
+
+    SAOFU_AVX2_TARGET int64_t avx2_sum_i64(const int64_t* v, size_t n) {
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_add_epi64(acc0, _mm256_loadu_si256((const __m256i*)(v + i)));
+            acc1 = _mm256_add_epi64(acc1, _mm256_loadu_si256((const __m256i*)(v + i + 4)));
+        }
+        alignas(32) int64_t lanes[4];
+        _mm256_store_si256((__m256i*)lanes, _mm256_add_epi64(acc0, acc1));
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar_sum(v, i, n);
+    }
+
+    SAOFU_AVX2_TARGET double avx2_sum_f64(const double* v, size_t n) {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(v + i));
+            acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(v + i + 4));
+        }
+        alignas(32) double lanes[4];
+        _mm256_store_pd(lanes, _mm256_add_pd(acc0, acc1));
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + scalar_sum(v, i, n);
+    }
+
+    SAOFU_AVX2_TARGET void avx2_min_max_i32(const int32_t* v, const uint64_t* validity, size_t n, int32_t& mn, int32_t& mx, bool& any) {
+        const __m256i hi = _mm256_set1_epi32(numeric_limits<int32_t>::max());
+        const __m256i lo = _mm256_set1_epi32(numeric_limits<int32_t>::min());
+        __m256i vmin = hi, vmax = lo;
+        uint32_t seen = 0;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint32_t bits = validity_bits(validity, i, 8);
+            seen |= bits;
+            __m256i m = lane_mask_epi32(bits);
+            __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+            vmin = _mm256_min_epi32(vmin, _mm256_blendv_epi8(hi, x, m));
+            vmax = _mm256_max_epi32(vmax, _mm256_blendv_epi8(lo, x, m));
+        }
+        if (seen) {
+            alignas(32) int32_t a[8], b[8];
+            _mm256_store_si256((__m256i*)a, vmin);
+            _mm256_store_si256((__m256i*)b, vmax);
+            mn = *min_element(a, a + 8);
+            mx = *max_element(b, b + 8);
+            any = true;
+        }
+        scalar_min_max(v, validity, i, n, mn, mx, any);
+    }
+
+    SAOFU_AVX2_TARGET void avx2_min_max_i64(const int64_t* v, const uint64_t* validity, size_t n, int64_t& mn, int64_t& mx, bool& any) {
+        const __m256i hi = _mm256_set1_epi64x(numeric_limits<int64_t>::max());
+        const __m256i lo = _mm256_set1_epi64x(numeric_limits<int64_t>::min());
+        __m256i vmin = hi, vmax = lo;
+        uint32_t seen = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            uint32_t bits = validity_bits(validity, i, 4);
+            seen |= bits;
+            __m256i m = lane_mask_epi64(bits);
+            __m256i x = _mm256_loadu_si256((const __m256i*)(v + i));
+            __m256i xmin = _mm256_blendv_epi8(hi, x, m);
+            __m256i xmax = _mm256_blendv_epi8(lo, x, m);
+            vmin = _mm256_blendv_epi8(vmin, xmin, _mm256_cmpgt_epi64(vmin, xmin));
+            vmax = _mm256_blendv_epi8(vmax, xmax, _mm256_cmpgt_epi64(xmax, vmax));
+        }
+        if (seen) {
+            alignas(32) int64_t a[4], b[4];
+            _mm256_store_si256((__m256i*)a, vmin);
+            _mm256_store_si256((__m256i*)b, vmax);
+            mn = *min_element(a, a + 4);
+            mx = *max_element(b, b + 4);
+            any = true;
+        }
+        scalar_min_max(v, validity, i, n, mn, mx, any);
+    }
+
+    SAOFU_AVX2_TARGET void avx2_min_max_f64(const double* v, const uint64_t* validity, size_t n, double& mn, double& mx, bool& any) {
+        const __m256d hi = _mm256_set1_pd(numeric_limits<double>::infinity());
+        const __m256d lo = _mm256_set1_pd(-numeric_limits<double>::infinity());
+        __m256d vmin = hi, vmax = lo;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d m = _mm256_castsi256_pd(lane_mask_epi64(validity_bits(validity, i, 4)));
+            __m256d x = _mm256_loadu_pd(v + i);
+            // 第一個運算元為 NaN 時 min/max_pd 回傳第二個，所以 NaN 會被略過
+            vmin = _mm256_min_pd(_mm256_blendv_pd(hi, x, m), vmin);
+            vmax = _mm256_max_pd(_mm256_blendv_pd(lo, x, m), vmax);
+        }
+        alignas(32) double a[4], b[4];
+        _mm256_store_pd(a, vmin);
+        _mm256_store_pd(b, vmax);
+        double block_min = *min_element(a, a + 4);
+        double block_max = *max_element(b, b + 4);
+        if (block_min <= block_max) {
+            mn = block_min;
+            mx = block_max;
+            any = true;
+        }
+        scalar_min_max(v, validity, i, n, mn, mx, any);
+    }
+
+    SAOFU_AVX2_TARGET size_t avx2_filter_i32(const int32_t* v, const uint64_t* validity, size_t n, CompareOp op, int32_t rhs, uint32_t* out) {
+        const __m256i k = _mm256_set1_epi32(rhs);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i c = compare_epi32(_mm256_loadu_si256((const __m256i*)(v + i)), k, op);
+            uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(c)) & validity_bits(validity, i, 8);
+            count += emit_selection(mask, i, out ? out + count : nullptr);
+        }
+        return count + scalar_filter(v, validity, i, n, op, rhs, out ? out + count : nullptr);
+    }
+
+    SAOFU_AVX2_TARGET size_t avx2_filter_i64(const int64_t* v, const uint64_t* validity, size_t n, CompareOp op, int64_t rhs, uint32_t* out) {
+        const __m256i k = _mm256_set1_epi64x(rhs);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256i c = compare_epi64(_mm256_loadu_si256((const __m256i*)(v + i)), k, op);
+            uint32_t mask = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(c)) & validity_bits(validity, i, 4);
+            count += emit_selection(mask, i, out ? out + count : nullptr);
+        }
+        return count + scalar_filter(v, validity, i, n, op, rhs, out ? out + count : nullptr);
+    }
+
+    SAOFU_AVX2_TARGET size_t avx2_filter_f64(const double* v, const uint64_t* validity, size_t n, CompareOp op, double rhs, uint32_t* out) {
+        const __m256d k = _mm256_set1_pd(rhs);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m256d c = compare_pd(_mm256_loadu_pd(v + i), k, op);
+            uint32_t mask = (uint32_t)_mm256_movemask_pd(c) & validity_bits(validity, i, 4);
+            count += emit_selection(mask, i, out ? out + count : nullptr);
+        }
+        return count + scalar_filter(v, validity, i, n, op, rhs, out ? out + count : nullptr);
+    }
+
+    bool cpu_has_avx2() {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, 1, 0);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx) return false;
+        // OS 必須有保存 YMM 暫存器
+        if ((_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+}
+#endif
+
+// ---------- 分派 ----------
+
+namespace {
+    template<typename T>
+    struct KernelTable {
+        typename ColumnSumType<T>::type (*sum)(const T*, size_t);
+        void (*min_max)(const T*, const uint64_t*, size_t, T&, T&, bool&);
+        size_t (*filter)(const T*, const uint64_t*, size_t, CompareOp, T, uint32_t*);
+    };
+
+    template<typename T>
+    typename ColumnSumType<T>::type scalar_sum_all(const T* v, size_t n) {
+        return scalar_sum(v, 0, n);
+    }
+
+    template<typename T>
+    void scalar_min_max_all(const T* v, const uint64_t* validity, size_t n, T& mn, T& mx, bool& any) {
+        scalar_min_max(v, validity, 0, n, mn, mx, any);
+    }
+
+    template<typename T>
+    size_t scalar_filter_all(const T* v, const uint64_t* validity, size_t n, CompareOp op, T rhs, uint32_t* out) {
+        return scalar_filter(v, validity, 0, n, op, rhs, out);
+    }
+
+    template<typename T>
+    KernelTable<T> scalar_table() {
+        return { &scalar_sum_all<T>, &scalar_min_max_all<T>, &scalar_filter_all<T> };
+    }
+
+    template<typename T> KernelTable<T> avx2_table();
+#if SAOFU_X86_KERNELS
+    template<> KernelTable<int32_t> avx2_table() { return { &avx2_sum_i32, &avx2_min_max_i32, &avx2_filter_i32 }; }
+    template<> KernelTable<int64_t> avx2_table() { return { &avx2_sum_i64, &avx2_min_max_i64, &avx2_filter_i64 }; }
+    template<> KernelTable<double> avx2_table() { return { &avx2_sum_f64, &avx2_min_max_f64, &avx2_filter_f64 }; }
+#else
+    template<typename T> KernelTable<T> avx2_table() { return scalar_table<T>(); }
+#endif
+
+    KernelIsa detect_isa() {
+#if SAOFU_X86_KERNELS
+        return cpu_has_avx2() ? KernelIsa::Avx2 : KernelIsa::Scalar;
+#else
+        return KernelIsa::Scalar;
+#endif
+    }
+
+    atomic<int> forced_isa{ -1 };
+
+    template<typename T>
+    KernelTable<T> kernels() {
+        static const KernelTable<T> scalar = scalar_table<T>();
+        static const KernelTable<T> avx2 = avx2_table<T>();
+        return active_kernel_isa() == KernelIsa::Avx2 ? avx2 : scalar;
+    }
+}
+
+KernelIsa SaoFU::active_kernel_isa() {
+    static const KernelIsa detected = detect_isa();
+    int forced = forced_isa.load(memory_order_relaxed);
+    // 不能強制使用 CPU 不支援的指令集
+    if (forced >= 0 && (KernelIsa)forced == KernelIsa::Scalar) {
+        return KernelIsa::Scalar;
+    }
+    return detected;
+}
+
+void SaoFU::force_kernel_isa(KernelIsa isa) {
+    forced_isa.store((int)isa, memory_order_relaxed);
+}
+
+const wchar_t* SaoFU::kernel_isa_name(KernelIsa isa) {
+    return isa == KernelIsa::Avx2 ? L"avx2" : L"scalar";
+}
+
+template<typename T>
+typename ColumnSumType<T>::type SaoFU::column_sum(const NumericColumn<T>& col) {
+    // NULL 位置為 0，加總時不必看 validity
+    return kernels<T>().sum(col.values.data(), col.values.size());
+}
+
+template<typename T>
+bool SaoFU::column_min(const NumericColumn<T>& col, T& out) {
+    T mn{}, mx{};
+    bool any = false;
+    kernels<T>().min_max(col.values.data(), col.validity.data(), col.values.size(), mn, mx, any);
+    if (any) out = mn;
+    return any;
+}
+
+template<typename T>
+bool SaoFU::column_max(const NumericColumn<T>& col, T& out) {
+    T mn{}, mx{};
+    bool any = false;
+    kernels<T>().min_max(col.values.data(), col.validity.data(), col.values.size(), mn, mx, any);
+    if (any) out = mx;
+    return any;
+}
+
+template<typename T>
+size_t SaoFU::column_count(const NumericColumn<T>& col) {
+    return col.values.size() - col.null_count;
+}
+
+template<typename T>
+size_t SaoFU::column_count_if(const NumericColumn<T>& col, CompareOp op, T rhs) {
+    return kernels<T>().filter(col.values.data(), col.validity.data(), col.values.size(), op, rhs, nullptr);
+}
+
+template<typename T>
+vector<uint32_t> SaoFU::column_filter(const NumericColumn<T>& col, CompareOp op, T rhs) {
+    // 先配到最大可能長度，emit_selection 直接寫入，最後再縮
+    vector<uint32_t> selection(col.values.size());
+    size_t n = kernels<T>().filter(col.values.data(), col.validity.data(), col.values.size(), op, rhs, selection.data());
+    selection.resize(n);
+    return selection;
+}
+
+#define SAOFU_INSTANTIATE_KERNELS(T)                                                              \
+    template ColumnSumType<T>::type SaoFU::column_sum<T>(const NumericColumn<T>&);                 \
+    template bool SaoFU::column_min<T>(const NumericColumn<T>&, T&);                               \
+    template bool SaoFU::column_max<T>(const NumericColumn<T>&, T&);                               \
+    template size_t SaoFU::column_count<T>(const NumericColumn<T>&);                               \
+    template size_t SaoFU::column_count_if<T>(const NumericColumn<T>&, CompareOp, T);              \
+    template vector<uint32_t> SaoFU::column_filter<T>(const NumericColumn<T>&, CompareOp, T);
+
+SAOFU_INSTANTIATE_KERNELS(int32_t)
+SAOFU_INSTANTIATE_KERNELS(int64_t)
+SAOFU_INSTANTIATE_KERNELS(double)
@@ -0,0 +1,81 @@
+﻿// ColumnKernels.h
+#ifndef COLUMN_KERNELS_H
+#define COLUMN_KERNELS_H
+
+#include "DataTable.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SaoFU {
+    // 連續存放的數值欄；validity 每列一個 bit（1 = 有值），NULL 位置的 values 固定為 0
+    template<typename T>
+    struct NumericColumn {
+        std::vector<T> values;
+        std::vector<std::uint64_t> validity;
+        std::size_t null_count = 0;
+
+        std::size_t size() const { return values.size(); }
+        bool is_valid(std::size_t i) const { return (validity[i >> 6] >> (i & 63)) & 1; }
+
+        void push_back(T v, bool valid) {
+            if ((values.size() & 63) == 0) {
+                validity.push_back(0);
+            }
+            if (valid) {
+                validity.back() |= 1ull << (values.size() & 63);
+            }
+            else {
+                ++null_count;
+            }
+            values.push_back(valid ? v : T{});
+        }
+    };
+
+    using Int32Column = NumericColumn<std::int32_t>;
+    using Int64Column = NumericColumn<std::int64_t>;
+    using DoubleColumn = NumericColumn<double>;
+
+    // 從 DataTable 抽出一欄；型別不符的 cell 視為 NULL
+    // Int32 只接受 SQL_INTEGER 以下的整數，Int64 接受所有整數，Double 接受所有數值
+    Int32Column extract_int32(const DataTable& table, const std::wstring& column);
+    Int64Column extract_int64(const DataTable& table, const std::wstring& column);
+    DoubleColumn extract_double(const DataTable& table, const std::wstring& column);
+
+    enum class CompareOp { Eq, Ne, Lt, Le, Gt, Ge };
+
+    enum class KernelIsa { Scalar, Avx2 };
+
+    // 第一次使用時依 CPUID 決定；force 主要給 benchmark 比較用
+    KernelIsa active_kernel_isa();
+    void force_kernel_isa(KernelIsa isa);
+    const wchar_t* kernel_isa_name(KernelIsa isa);
+
+    template<typename T> struct ColumnSumType { using type = std::int64_t; };
+    template<> struct ColumnSumType<double> { using type = double; };
+
+    // 以下對 Int32Column / Int64Column / DoubleColumn 有實作，NULL 一律略過
+    template<typename T>
+    typename ColumnSumType<T>::type column_sum(const NumericColumn<T>& col);
+
+    // 全部為 NULL 時回傳 false
+    template<typename T>
+    bool column_min(const NumericColumn<T>& col, T& out);
+    template<typename T>
+    bool column_max(const NumericColumn<T>& col, T& out);
+
+    // 非 NULL 的列數
+    template<typename T>
+    std::size_t column_count(const NumericColumn<T>& col);
+
+    // 符合 value <op> rhs 的列數
+    template<typename T>
+    std::size_t column_count_if(const NumericColumn<T>& col, CompareOp op, T rhs);
+
+    // 回傳符合條件的列號（selection vector），遞增排列
+    template<typename T>
+    std::vector<std::uint32_t> column_filter(const NumericColumn<T>& col, CompareOp op, T rhs);
+}
+
+#endif // COLUMN_KERNELS_H
@@ -1,159 +1,199 @@
 ﻿#include <windows.h>
-#include <winevt.h>
 #include <iostream>
 #include <sddl.h>
 #include <io.h>
 #include <fcntl.h>
 
-#pragma comment(lib, "wevtapi.lib")
 #include <string>
 #include <vector>
+#include <thread>
 
+#include "Benchmarks.h"
+#include "DataBaseException.h"
 #include "DatabaseAccess.h"
-
-std::wstring formatFileTimeToSQLDateTime(const FILETIME* ft) {
-    FILETIME localFt;
-    SYSTEMTIME st;
-
-    // 轉成本地時間
-    FileTimeToLocalFileTime(ft, &localFt);
-    FileTimeToSystemTime(&localFt, &st);
-
-    wchar_t date_buf[64];
-    wchar_t time_buf[64];
-
-    if (GetDateFormatEx(LOCALE_NAME_USER_DEFAULT, 0, &st, nullptr, date_buf, 64, nullptr) &&
-        GetTimeFormatEx(LOCALE_NAME_USER_DEFAULT, 0, &st, nullptr, time_buf, 64)) {
-
-        wchar_t result_buf[128];
-        swprintf(result_buf, 128, L"%s %s.%03d", date_buf, time_buf, st.wMilliseconds);
-        return result_buf;
+#include "EventSource.h"
+#include "Ingest.h"
+#include "LoadHarness.h"
+
+// 回傳 name 後面的參數，沒有時回傳 nullptr
+const wchar_t* optionValue(int argc, wchar_t* argv[], const wchar_t* name) {
+    for (int i = 1; i + 1 < argc; ++i) {
+        if (std::wstring(argv[i]) == name) {
+            return argv[i + 1];
+        }
     }
-
-    return L"";
+    return nullptr;
 }
 
-std::wstring FormatEventMessage(EVT_HANDLE hMetadata, EVT_HANDLE hEvent, DWORD flags) {
-    DWORD dwBufferUsed = 0;
-    std::vector<WCHAR> messageBuffer;
-
-    if (!EvtFormatMessage(hMetadata, hEvent, 0, 0, NULL, flags, 0, NULL, &dwBufferUsed)) {
-        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
-            messageBuffer.resize(dwBufferUsed);
-            if (EvtFormatMessage(hMetadata, hEvent, 0, 0, NULL, flags, dwBufferUsed, messageBuffer.data(), &dwBufferUsed)) {
-                return std::wstring(messageBuffer.data());
-            }
-            else {
-                return L"Failed to format message. Error: " + std::to_wstring(GetLastError());
-            }
-        }
-        else {
-            LPVOID lpMsgBuf;
-            DWORD bufLen = FormatMessageW(
-                FORMAT_MESSAGE_ALLOCATE_BUFFER |
-                FORMAT_MESSAGE_FROM_SYSTEM |
-                FORMAT_MESSAGE_IGNORE_INSERTS,
-                NULL,
-                GetLastError(),
-                MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-                (LPWSTR)&lpMsgBuf,
-                0, 
-                NULL
-            );
-            return L"Failed to get required buffer size. Error: " + std::wstring((LPWSTR)lpMsgBuf) + L" " + std::to_wstring(GetLastError());
+bool hasOption(int argc, wchar_t* argv[], const wchar_t* name) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::wstring(argv[i]) == name) {
+            return true;
         }
     }
-    return L"";
+    return false;
 }
 
-// 事件订阅回调函数
-DWORD WINAPI EvtSubscribeCallback(EVT_SUBSCRIBE_NOTIFY_ACTION action, DatabaseAccess* context, EVT_HANDLE hEvent) {
-    if (action == EvtSubscribeActionDeliver) {
-        std::wcout << L"\n=== New Event Received ===\n";
-        DWORD status = ERROR_SUCCESS;
-        EVT_HANDLE hContext = EvtCreateRenderContext(0, NULL, EvtRenderContextSystem);
-        if (!hContext) {
-            return GetLastError();
-        }
+// --aggregate [seconds]：同一事件在視窗內只寫第一次，其餘彙總到 summary_table
+// 重播時 event_time_clock 為 true，視窗依事件時間結束，與重播速度無關
+void configureAggregator(int argc, wchar_t* argv[], SaoFU::IngestContext& ingest, bool event_time_clock = false) {
+    if (!hasOption(argc, argv, L"--aggregate")) {
+        return;
+    }
+    SaoFU::AggregatorOptions options;
+    const wchar_t* window = optionValue(argc, argv, L"--aggregate");
+    if (window && _wtoi(window) > 0) {
+        options.window = std::chrono::seconds(_wtoi(window));
+    }
+    options.event_time_clock = event_time_clock;
+    ingest.aggregator = std::make_unique<SaoFU::EventAggregator>(options);
+}
 
-        DWORD dwBufferUsed = 0;
-        DWORD dwPropertyCount = 0;
+void printAggregatorStats(const SaoFU::IngestContext& ingest) {
+    if (!ingest.aggregator) {
+        return;
+    }
+    SaoFU::AggregatorStats stats = ingest.aggregator->stats();
+    std::wcout << L"Aggregated: observed " << stats.observed << L", inserted " << stats.passed
+        << L", suppressed " << stats.suppressed << L", summaries " << stats.summaries
+        << L", evicted " << stats.evicted << L"\n";
+}
 
-        // 取得所需的 Buffer 大小
-        if (!EvtRender(hContext, hEvent, EvtRenderEventValues, 0, NULL, &dwBufferUsed, &dwPropertyCount)) {
-            if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
-                EvtClose(hContext);
-                return GetLastError();
-            }
+// --overload block|drop|shed|sample [--queue N] [--sample N]：佇列的過載策略，水位依容量的 80% / 20%
+// --block 等同 --overload block；回傳 false 表示參數不合法
+bool configureOverload(int argc, wchar_t* argv[], SaoFU::OverloadOptions& options) {
+    if (hasOption(argc, argv, L"--block")) {
+        options.policy = SaoFU::OverloadPolicy::Block;
+    }
+    if (const wchar_t* v = optionValue(argc, argv, L"--overload")) {
+        std::wstring policy = v;
+        if (policy == L"block") options.policy = SaoFU::OverloadPolicy::Block;
+        else if (policy == L"drop") options.policy = SaoFU::OverloadPolicy::Drop;
+        else if (policy == L"shed") options.policy = SaoFU::OverloadPolicy::Shed;
+        else if (policy == L"sample") options.policy = SaoFU::OverloadPolicy::Sample;
+        else {
+            std::wcerr << L"Unknown overload policy: " << policy << L"\n";
+            return false;
         }
+    }
+    if (const wchar_t* v = optionValue(argc, argv, L"--queue")) {
+        options.capacity = (size_t)_wtoi64(v);
+        options.high_watermark = options.capacity * 8 / 10;
+        options.low_watermark = options.capacity / 5;
+    }
+    if (const wchar_t* v = optionValue(argc, argv, L"--sample")) options.sample_every = (size_t)_wtoi64(v);
+    return true;
+}
 
-        // 使用 std::vector 來管理 Buffer
-        std::vector<BYTE> buffer(dwBufferUsed);
-        PEVT_VARIANT pRenderedValues = (PEVT_VARIANT)buffer.data();
-
-        if (!EvtRender(hContext, hEvent, EvtRenderEventValues, dwBufferUsed, pRenderedValues, &dwBufferUsed,
-            &dwPropertyCount)) {
-            EvtClose(hContext);
-            return GetLastError();
-        }
+// ConsoleApplication1.exe --loadgen synthetic [--rate N] [--count N] [--providers N] [--event-ids N]
+//                                           [--zipf S] [--message-size N] [--unique R]
+// ConsoleApplication1.exe --loadgen replay <file.jsonl|file.xml> [--speed X]
+// 共用：[--connect <ODBC 連線字串>] [--database 名稱] [--table 名稱] [--summary-table 名稱]
+//       [--aggregate [seconds]] [--overload block|drop|shed|sample] [--queue N] [--sample N] [--block]
+// 沒有 --connect 時為 dry run：跑完來源、渲染與彙總，但不寫入資料庫
+int runLoadgen(int argc, wchar_t* argv[]) {
+    const wchar_t* kind = optionValue(argc, argv, L"--loadgen");
+    if (!kind) {
+        std::wcerr << L"--loadgen requires synthetic or replay\n";
+        return 1;
+    }
 
-        // 從事件取得 Publisher 名稱，以開啟 Metadata
-        EVT_HANDLE hMetadata = NULL;
-        DWORD dwPublisherBufferUsed = 0;
-        if (!EvtRender(hContext, hEvent, EvtRenderEventValues, dwBufferUsed, pRenderedValues, &dwPublisherBufferUsed, &dwPropertyCount)) {
-            EvtClose(hContext);
-            return GetLastError();
+    std::unique_ptr<SaoFU::EventSource> source;
+    SaoFU::ReplayEventSource* replay = nullptr;
+    if (std::wstring(kind) == L"synthetic") {
+        SaoFU::SyntheticOptions options;
+        if (const wchar_t* v = optionValue(argc, argv, L"--rate")) options.rate = _wtof(v);
+        if (const wchar_t* v = optionValue(argc, argv, L"--count")) options.count = (size_t)_wtoi64(v);
+        if (const wchar_t* v = optionValue(argc, argv, L"--providers")) options.provider_count = (size_t)_wtoi64(v);
+        if (const wchar_t* v = optionValue(argc, argv, L"--event-ids")) options.event_id_count = (size_t)_wtoi64(v);
+        if (const wchar_t* v = optionValue(argc, argv, L"--zipf")) options.zipf_s = _wtof(v);
+        if (const wchar_t* v = optionValue(argc, argv, L"--message-size")) options.message_mean = _wtof(v);
+        if (const wchar_t* v = optionValue(argc, argv, L"--unique")) options.unique_ratio = _wtof(v);
+        source = std::make_unique<SaoFU::SyntheticEventSource>(options);
+    }
+    else if (std::wstring(kind) == L"replay") {
+        const wchar_t* path = optionValue(argc, argv, L"replay");
+        if (!path) {
+            std::wcerr << L"--loadgen replay requires a file\n";
+            return 1;
         }
+        SaoFU::ReplayOptions options;
+        options.path = path;
+        if (const wchar_t* v = optionValue(argc, argv, L"--speed")) options.speed = _wtof(v);
+        auto r = std::make_unique<SaoFU::ReplayEventSource>(options);
+        replay = r.get();
+        source = std::move(r);
+    }
+    else {
+        std::wcerr << L"Unknown load source: " << kind << L"\n";
+        return 1;
+    }
 
-        if (pRenderedValues[EvtSystemProviderName].Type == EvtVarTypeString) {
-            hMetadata = EvtOpenPublisherMetadata(NULL, pRenderedValues[EvtSystemProviderName].StringVal, NULL, 0, 0);
+    SaoFU::IngestContext ingest;
+    ingest.verbose = false;
+    configureAggregator(argc, argv, ingest, replay != nullptr);
+    if (const wchar_t* v = optionValue(argc, argv, L"--table")) ingest.table = v;
+    if (const wchar_t* v = optionValue(argc, argv, L"--summary-table")) ingest.summary_table = v;
+
+    DatabaseAccess db;
+    if (const wchar_t* conn = optionValue(argc, argv, L"--connect")) {
+        db.connect(conn);
+        if (const wchar_t* database = optionValue(argc, argv, L"--database")) {
+            db.set_database(database);
         }
+        ingest.db = &db;
+    }
+    else {
+        std::wcout << L"No --connect given, running without database writes.\n";
+    }
 
-        std::wstring MessageEvent = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageEvent);
-        std::wstring MessageProvider = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageProvider);
-        std::wstring MessageKeyword = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageKeyword);
-        std::wstring MessageTask = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageTask);
-
-        SYSTEMTIME st;
-        ULONGLONG ullTimeStamp = pRenderedValues[EvtSystemTimeCreated].FileTimeVal;
-        std::wstring file_time = formatFileTimeToSQLDateTime((FILETIME*)&ullTimeStamp);
-
-        wprintf(L"Provider: %s | EventID: %u  | Time: %s\n",
-            pRenderedValues[EvtSystemProviderName].StringVal, //來源
-            pRenderedValues[EvtSystemEventID].UInt16Val,      //事件識別碼
-            file_time.c_str()                                 //日期和時間
-        );
-
-        context->insert_identity_key(
-        L"event.dbo.even", 
-        L"關鍵字,日期和時間,事件識別碼,來源,工作類別,內容,LogDate",
-            MessageKeyword,
-            *(FILETIME*)&ullTimeStamp,
-            pRenderedValues[EvtSystemEventID].UInt16Val,
-            MessageTask,
-            MessageKeyword,
-            MessageEvent,
-            (SaoFU::SQLCMD)L"SYSDATETIME()"
-        );
-
-
-        //sprintf();
-        //DA->command();
-
-
-        if (hMetadata)
-            EvtClose(hMetadata);
+    SaoFU::LoadOptions options;
+    if (!configureOverload(argc, argv, options.overload)) {
+        return 1;
+    }
 
-        EvtClose(hContext);
-        return status;
+    SaoFU::LoadReport report = SaoFU::run_load(*source, ingest, options);
+    SaoFU::print_load_report(report);
+    printAggregatorStats(ingest);
+    if (replay && replay->skipped() > 0) {
+        std::wcout << L"Skipped records: " << replay->skipped() << L"\n";
     }
     return 0;
 }
 
-int main() {
+int wmain(int argc, wchar_t* argv[]) {
     _setmode(_fileno(stdout), _O_U16TEXT);
     _setmode(_fileno(stderr), _O_U16TEXT);
 
+    // ConsoleApplication1.exe --bench <name> [rows]
+    if (argc >= 3 && std::wstring(argv[1]) == L"--bench") {
+        size_t rows = argc >= 4 ? (size_t)_wtoi64(argv[3]) : 0;
+        return SaoFU::run_benchmark(argv[2], rows);
+    }
+
+    if (hasOption(argc, argv, L"--loadgen")) {
+        try {
+            return runLoadgen(argc, argv);
+        }
+        catch (const SaoFU::DataBaseException& ex) {
+            ex.log();
+        }
+        catch (const std::exception& ex) {
+            std::wcerr << ex.what() << std::endl;
+        }
+        return 1;
+    }
+
+    SaoFU::IngestContext ingest;
+    configureAggregator(argc, argv, ingest);
+
+    // 訂閱回呼只負責放進佇列，資料庫比事件慢時由過載策略決定等待或丟棄
+    SaoFU::OverloadOptions overload;
+    if (!configureOverload(argc, argv, overload)) {
+        return 1;
+    }
+    SaoFU::IngestQueue queue(overload);
+
     const wchar_t* query = LR"(
         <QueryList>
           <Query Id="0" Path="Application">
@@ -171,26 +211,45 @@ int main() {
     std::unique_ptr<DatabaseAccess> DA = std::make_unique<DatabaseAccess>();
     DA->connect(L"DESKTOP-SO1AP2J", L"sa", L"Ww920626@")
         .set_database(L"event");
+    ingest.db = DA.get();
+
+    SaoFU::WindowsEventSource source(query);
+    std::thread flusher = SaoFU::start_summary_flusher(ingest);
+    std::thread writer([&] {
+        SaoFU::EventRecord e;
+        while (queue.pop(e)) {
+            try {
+                SaoFU::ingest_event(ingest, e);
+            }
+            catch (const SaoFU::DataBaseException& ex) {
+                ex.log();
+            }
+            catch (const std::exception& ex) {
+                std::wcerr << ex.what() << std::endl;
+            }
+        }
+    });
+
+    // 主執行緒留給訂閱，訂閱失敗時可以直接結束；Enter 由另一條執行緒等待
+    std::thread([&source] {
+        std::wcin.get();
+        source.stop();
+    }).detach();
 
-    EVT_HANDLE hSubscription = EvtSubscribe(
-        NULL,
-        NULL,
-        NULL,
-        query,
-        NULL,
-        DA.get(),
-        (EVT_SUBSCRIBE_CALLBACK)EvtSubscribeCallback,
-        EvtSubscribeToFutureEvents
-    );
-    
-    if (!hSubscription) {
-        std::wcerr << L"Failed to subscribe to events. Error: " << GetLastError() << std::endl;
-        return 1;
-    }
-    
     std::wcout << L"Listening for events...\nPress Enter to exit.\n";
-    std::wcin.get();
-    
-    EvtClose(hSubscription);
-    return 0;
+    int rc = 0;
+    try {
+        source.run([&](SaoFU::EventRecord&& e) { queue.push(std::move(e)); });
+    }
+    catch (const std::runtime_error& e) {
+        std::wcerr << e.what() << std::endl;
+        rc = 1;
+    }
+
+    queue.close();
+    writer.join();
+    SaoFU::stop_summary_flusher(ingest, flusher);
+    SaoFU::print_overload_stats(queue.stats());
+    printAggregatorStats(ingest);
+    return rc;
 }
@@ -1,42 +1,105 @@
 ﻿#include "DataBaseException.h"
 
+#include <atomic>
 #include <iostream>
 #include <sstream>
 
 using namespace SaoFU;
 using namespace std;
 
-DataBaseException::DataBaseException(const wstring& message, SQLHANDLE hHandle, SQLSMALLINT hType) {
+static atomic<bool> logging_enabled{ true };
+
+DataBaseException::DataBaseException(const wstring& message, SQLHANDLE hHandle, SQLSMALLINT hType)
+    : context(message), formatted(make_shared<Message>()) {
     SQLSMALLINT iRec = 1;
     SQLINTEGER  iError;
     WCHAR       wszMessage[1000] = { 0 };
     WCHAR       wszState[SQL_SQLSTATE_SIZE + 1];
 
-    wostringstream oss;
-
-    if (!message.empty()) {
-        oss << message << endl;
-    }
-
     while (SQLGetDiagRec(hType, hHandle, iRec, wszState, &iError, wszMessage, (SQLSMALLINT)(sizeof(wszMessage) / sizeof(WCHAR)), (SQLSMALLINT*)NULL) == SQL_SUCCESS) {
         if (wcsncmp(wszState, L"01004", 5)) {
-            WCHAR tmpMessage[1000];
-            swprintf(tmpMessage, L"[%5.5s] %s (%d)\n", wszState, wszMessage, iError);
-            oss << tmpMessage;
+            records.push_back({ wstring(wszState, wcsnlen(wszState, SQL_SQLSTATE_SIZE)), iError, wszMessage });
         }
         ++iRec;
     }
 
-    if (oss.str().empty()) {
-        oss << "Unknown ODBC error.";
+    if (!records.empty()) {
+        state = records.front().state;
     }
+}
 
-    this->message = oss.str();
-    wcerr << this->message << endl;
+DataBaseException::DataBaseException(const wstring& message, const wstring& sqlstate)
+    : context(message), state(sqlstate), formatted(make_shared<Message>()) {
 }
 
+const wchar_t* DataBaseException::what() const noexcept {
+    try {
+        call_once(formatted->once, [this] {
+            wostringstream oss;
+
+            if (!context.empty()) {
+                oss << context << endl;
+            }
 
+            for (const auto& rec : records) {
+                WCHAR tmpMessage[1000];
+                swprintf(tmpMessage, L"[%5.5s] %s (%d)\n", rec.state.c_str(), rec.message.c_str(), rec.native_error);
+                oss << tmpMessage;
+            }
 
-const wchar_t* DataBaseException::what() const noexcept {
-    return message.c_str();
+            if (oss.str().empty()) {
+                oss << "Unknown ODBC error.";
+            }
+
+            formatted->text = oss.str();
+        });
+    }
+    catch (...) {
+        return context.c_str();
+    }
+    return formatted->text.c_str();
+}
+
+const wstring& DataBaseException::sqlstate() const noexcept {
+    return state;
+}
+
+const vector<DiagRecord>& DataBaseException::diagnostics() const noexcept {
+    return records;
+}
+
+bool DataBaseException::is_transient() const noexcept {
+    static const wchar_t* transient_states[] = {
+        L"08S01", // 通訊連結失敗
+        L"08001", // 無法建立連線
+        L"08007", // 交易期間連線中斷
+        L"40001", // 死結 / 序列化失敗
+        L"HYT00", // 逾時
+        L"HYT01", // 連線逾時
+    };
+
+    for (const wchar_t* s : transient_states) {
+        if (state == s) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool DataBaseException::is_timeout() const noexcept {
+    return state == L"HYT00";
+}
+
+bool DataBaseException::is_connection_error() const noexcept {
+    return state.size() == 5 && state[0] == L'0' && state[1] == L'8';
+}
+
+void DataBaseException::log() const {
+    if (logging_enabled.load(memory_order_relaxed)) {
+        wcerr << what() << endl;
+    }
+}
+
+void DataBaseException::set_logging(bool enabled) noexcept {
+    logging_enabled.store(enabled, memory_order_relaxed);
 }
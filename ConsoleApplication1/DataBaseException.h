@@ -5,14 +5,54 @@
 #define NOMINMAX
 #include <windows.h>
 #include <sqlext.h> 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace SaoFU {
-    class DataBaseException {
+    struct DiagRecord {
+        std::wstring state;
+        SQLINTEGER native_error;
         std::wstring message;
+    };
+
+    class DataBaseException {
+        std::wstring context;
+        std::wstring state;
+        std::vector<DiagRecord> records;
+        // what() 第一次呼叫時才組字串；複製出去的例外共用同一份，call_once 讓多條執行緒同時呼叫也安全
+        struct Message {
+            std::once_flag once;
+            std::wstring text;
+        };
+        std::shared_ptr<Message> formatted;
     public:
         DataBaseException(const std::wstring& message, SQLHANDLE hHandle, SQLSMALLINT hType);
+        // 不經 ODBC 診斷、由程式自行產生的錯誤
+        DataBaseException(const std::wstring& message, const std::wstring& sqlstate);
         const wchar_t* what() const noexcept;
+        // 第一筆診斷紀錄的 SQLSTATE（略過 01004），沒有時為空字串
+        const std::wstring& sqlstate() const noexcept;
+        const std::vector<DiagRecord>& diagnostics() const noexcept;
+
+        // 連線中斷、死結、逾時等重試可能成功的錯誤
+        // 查詢逾時（HYT00）會讓總等待時間變成 timeout 的倍數，DatabaseAccess 只在 RetryPolicy::retry_timeouts 時重試
+        bool is_transient() const noexcept;
+        bool is_timeout() const noexcept;
+        // SQLSTATE 08xxx，代表連線本身已不可用
+        bool is_connection_error() const noexcept;
+
+        // 寫到 wcerr；由 DatabaseAccess 在錯誤確定要交給呼叫端時呼叫，建構時不再輸出
+        void log() const;
+        static void set_logging(bool enabled) noexcept;
+    };
+
+    // 逾時（HYT00）或被 SQLCancel 取消（HY008）時丟出
+    class QueryTimeoutException : public DataBaseException {
+    public:
+        explicit QueryTimeoutException(const DataBaseException& e) : DataBaseException(e) {}
+        bool is_cancelled() const noexcept { return sqlstate() == L"HY008"; }
     };
 }
 
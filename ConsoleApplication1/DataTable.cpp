@@ -9,83 +9,270 @@
 #include <string>
 #include <vector>
 #include <algorithm>
-#include <sstream>
-#include <iomanip>
 #include <unordered_map>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
 
 using namespace SaoFU;
 using namespace std;
 
-SQLSMALLINT SaoFU::sql_to_ctype(SQLSMALLINT sql_type) {
-    static const unordered_map<SQLSMALLINT, SQLSMALLINT> sql_to_ctype_map = {
-        // r
-        {SQL_CHAR,          SQL_C_CHAR},
-        {SQL_VARCHAR,       SQL_C_CHAR},
-        {SQL_LONGVARCHAR,   SQL_C_CHAR},
-        {SQL_WCHAR,         SQL_C_WCHAR},
-        {SQL_WVARCHAR,      SQL_C_WCHAR},
-        {SQL_WLONGVARCHAR,  SQL_C_WCHAR},
+namespace {
+    // ---------- NUMERIC / DECIMAL ----------
+    // SQL_NUMERIC_STRUCT  val O 16 bytes little-endian ȡAsign 1 B0 t
 
-        // ƭ
-        {SQL_TINYINT,       SQL_C_UTINYINT},
-        {SQL_SMALLINT,      SQL_C_SSHORT},
-        {SQL_INTEGER,       SQL_C_SLONG},
-        {SQL_BIGINT,        SQL_C_SBIGINT},
-        {SQL_REAL,          SQL_C_FLOAT},
-        {SQL_FLOAT,         SQL_C_DOUBLE},
-        {SQL_DOUBLE,        SQL_C_DOUBLE},
-        {SQL_BIT,           SQL_C_BIT},
+    bool is_zero(const SQLCHAR (&v)[SQL_MAX_NUMERIC_LEN]) {
+        for (SQLCHAR b : v) {
+            if (b) return false;
+        }
+        return true;
+    }
 
-        // ɶ
-        {SQL_TYPE_DATE,     SQL_C_TYPE_DATE},
-        {SQL_TYPE_TIME,     SQL_C_TYPE_TIME},
-        {SQL_TYPE_TIMESTAMP,SQL_C_TYPE_TIMESTAMP},
+    // NaH dA^Ǿl
+    unsigned divide_small(SQLCHAR (&v)[SQL_MAX_NUMERIC_LEN], unsigned d) {
+        unsigned rem = 0;
+        for (int i = SQL_MAX_NUMERIC_LEN - 1; i >= 0; --i) {
+            unsigned cur = (rem << 8) | v[i];
+            v[i] = (SQLCHAR)(cur / d);
+            rem = cur % d;
+        }
+        return rem;
+    }
 
-        // Binary / rowversion
-        {SQL_BINARY,        SQL_C_BINARY},
-        {SQL_VARBINARY,     SQL_C_BINARY},
-        {SQL_LONGVARBINARY, SQL_C_BINARY},
-        {98,                SQL_C_BINARY} // SQL_ROWVERSION
+    bool read_numeric(const DataCell& cell, SQL_NUMERIC_STRUCT& out) {
+        if (cell.buffer.size() < sizeof(out)) return false;
+        memcpy(&out, cell.buffer.data(), sizeof(out));
+        return true;
+    }
+
+    // Ihpƫoi long long ɦ^ trueFexact ܺIhO_ 0
+    bool numeric_to_int64(const SQL_NUMERIC_STRUCT& n, long long& out, bool& exact) {
+        SQLCHAR v[SQL_MAX_NUMERIC_LEN];
+        memcpy(v, n.val, sizeof(v));
+        exact = true;
+        for (int s = 0; s < n.scale; ++s) {
+            if (divide_small(v, 10) != 0) exact = false;
+        }
+
+        for (int i = 8; i < SQL_MAX_NUMERIC_LEN; ++i) {
+            if (v[i]) return false;
+        }
+        unsigned long long magnitude = 0;
+        for (int i = 7; i >= 0; --i) {
+            magnitude = (magnitude << 8) | v[i];
+        }
+        // t scale ܾƳ٭nW 10^-scale
+        for (int s = n.scale; s < 0; ++s) {
+            if (magnitude > ULLONG_MAX / 10) return false;
+            magnitude *= 10;
+        }
+
+        const unsigned long long limit = n.sign ? (unsigned long long)LLONG_MAX : (unsigned long long)LLONG_MAX + 1;
+        if (magnitude > limit) return false;
+        out = n.sign ? (long long)magnitude : (long long)(0 - magnitude);
+        return true;
+    }
+
+    double numeric_to_double(const SQL_NUMERIC_STRUCT& n) {
+        double v = 0;
+        for (int i = SQL_MAX_NUMERIC_LEN - 1; i >= 0; --i) {
+            v = v * 256 + n.val[i];
+        }
+        v /= pow(10.0, n.scale);
+        return n.sign ? v : -v;
+    }
+
+    wstring numeric_to_wstring(const SQL_NUMERIC_STRUCT& n) {
+        SQLCHAR v[SQL_MAX_NUMERIC_LEN];
+        memcpy(v, n.val, sizeof(v));
+
+        // ϦVͤQiƦrAܤ֭n scale + 1 ~pIe 0
+        wstring digits;
+        while (!is_zero(v)) {
+            digits.push_back((wchar_t)(L'0' + divide_small(v, 10)));
+        }
+        for (int s = n.scale; s < 0; ++s) {
+            digits.insert(digits.begin(), L'0');
+        }
+        const size_t scale = n.scale > 0 ? (size_t)n.scale : 0;
+        while (digits.size() <= scale) {
+            digits.push_back(L'0');
+        }
+
+        wstring out;
+        if (!n.sign && !is_zero(n.val)) out.push_back(L'-');
+        for (size_t i = digits.size(); i-- > 0;) {
+            out.push_back(digits[i]);
+            if (i == scale && scale > 0) out.push_back(L'.');
+        }
+        return out;
+    }
+
+    // ΪWƤQiGdigits he᪺ 0Aexponent pIeơFȬ 0  digits OŪ
+    struct DecimalKey {
+        bool negative = false;
+        int exponent = 0;
+        string digits;
     };
 
-    auto it = sql_to_ctype_map.find(sql_type);
-    if (it != sql_to_ctype_map.end()) {
-        return it->second;
+    DecimalKey decimal_key(const SQL_NUMERIC_STRUCT& n) {
+        SQLCHAR v[SQL_MAX_NUMERIC_LEN];
+        memcpy(v, n.val, sizeof(v));
+        string reversed;
+        while (!is_zero(v)) {
+            reversed.push_back((char)('0' + divide_small(v, 10)));
+        }
+
+        DecimalKey key;
+        if (reversed.empty()) return key;
+        key.negative = !n.sign;
+        key.exponent = (int)reversed.size() - n.scale;
+        size_t trailing = reversed.find_first_not_of('0');
+        key.digits.assign(reversed.rbegin(), reversed.rend() - trailing);
+        return key;
     }
-    return SQL_C_BINARY; // fallback
-}
 
-DataCell::DataCell() = default;
+    // g doubleA׶WL 15 쪺 DECIMAL ]
+    int compare_decimal(const DecimalKey& a, const DecimalKey& b) {
+        if (a.negative != b.negative) return a.negative ? -1 : 1;
+        int c;
+        if (a.digits.empty() || b.digits.empty()) c = (int)!a.digits.empty() - (int)!b.digits.empty();
+        else if (a.exponent != b.exponent) c = a.exponent < b.exponent ? -1 : 1;
+        else c = a.digits.compare(b.digits);
+        c = c < 0 ? -1 : (c > 0 ? 1 : 0);
+        return a.negative ? -c : c;
+    }
 
-DataCell::DataCell(vector<BYTE>&& buf, bool is_null, const ColumnMeta& m): buffer(move(buf)), null_flag(is_null), meta(m) {
-}
+    // double OƪGipơAiHTi}QiFd O
+    DecimalKey double_decimal_key(double d) {
+        DecimalKey key;
+        int e;
+        unsigned long long mantissa = (unsigned long long)ldexp(frexp(fabs(d), &e), 53);
+        if (mantissa == 0) return key;
+        e -= 53;
 
-template <typename T>
-T DataCell::get() const {
-    if (null_flag || buffer.size() < sizeof(T)) {
-        throw runtime_error("Invalid or NULL data for requested type");
+        // little-endian QiƦrAȬ digits * 10^shift
+        string digits;
+        for (unsigned long long x = mantissa; x; x /= 10) {
+            digits.push_back((char)(x % 10));
+        }
+        auto multiply = [&digits](int factor) {
+            int carry = 0;
+            for (char& c : digits) {
+                int v = c * factor + carry;
+                c = (char)(v % 10);
+                carry = v / 10;
+            }
+            for (; carry; carry /= 10) digits.push_back((char)(carry % 10));
+        };
+        int shift = 0;
+        for (; e > 0; --e) multiply(2);
+        for (; e < 0; ++e) {
+            multiply(5); // 2^-1 = 5 * 10^-1
+            --shift;
+        }
+
+        size_t trailing = 0;
+        while (digits[trailing] == 0) ++trailing;
+        key.negative = d < 0;
+        key.exponent = (int)digits.size() + shift;
+        for (size_t i = digits.size(); i-- > trailing;) {
+            key.digits.push_back((char)('0' + digits[i]));
+        }
+        return key;
     }
-    return *(const T*)buffer.data();
-}
 
-wstring DataCell::to_string() const {
-    if (null_flag || buffer.empty()) return L"(NULL)";
+    // ȭnY double ɦ^ true
+    // M * 10^-scale = o * 2^(t - scale) * 5^-scaleGo nQ 5^scale 㰣AѤU_Ʃoi 53 bits
+    bool numeric_exact_double(const SQL_NUMERIC_STRUCT& n, double& out) {
+        SQLCHAR v[SQL_MAX_NUMERIC_LEN];
+        memcpy(v, n.val, sizeof(v));
+        if (is_zero(v)) {
+            out = 0;
+            return true;
+        }
+        int twos = 0;
+        while ((v[0] & 1) == 0) {
+            divide_small(v, 2);
+            ++twos;
+        }
+        for (int s = 0; s < n.scale; ++s) {
+            if (divide_small(v, 5) != 0) return false;
+        }
+        for (int i = 8; i < SQL_MAX_NUMERIC_LEN; ++i) {
+            if (v[i]) return false;
+        }
+        unsigned long long odd = 0;
+        for (int i = 7; i >= 0; --i) {
+            odd = (odd << 8) | v[i];
+        }
+        const unsigned long long limit = 1ull << 53;
+        for (int s = n.scale; s < 0; ++s) {
+            if (odd > limit / 5) return false;
+            odd *= 5;
+        }
+        if (odd >= limit) return false;
+        out = ldexp((double)odd, twos - n.scale);
+        if (!n.sign) out = -out;
+        return true;
+    }
 
-    switch (meta.data_type) {
-    case SQL_WCHAR:
-    case SQL_WVARCHAR:
-    case SQL_WLONGVARCHAR:
-        return get<wstring>();
-    case SQL_CHAR:
-    case SQL_VARCHAR:
-    case SQL_LONGVARCHAR: {
-        string ascii_str((const char*)buffer.data(), buffer.size());
-        ascii_str.append(1, '\0');
-        return wstring(ascii_str.begin(), ascii_str.end());
+    SQL_NUMERIC_STRUCT int64_to_numeric(long long v) {
+        SQL_NUMERIC_STRUCT n{};
+        n.precision = 19;
+        n.sign = v >= 0 ? 1 : 0;
+        unsigned long long magnitude = v >= 0 ? (unsigned long long)v : 0 - (unsigned long long)v;
+        for (int i = 0; i < 8; ++i) {
+            n.val[i] = (SQLCHAR)(magnitude >> (8 * i));
+        }
+        return n;
     }
 
-    case SQL_TYPE_DATE: {
-        const DATE_STRUCT* d = (const DATE_STRUCT*)buffer.data();
+    template<typename T>
+    T numeric_as(const DataCell& cell) {
+        SQL_NUMERIC_STRUCT n;
+        if (!read_numeric(cell, n)) {
+            throw runtime_error("Invalid NUMERIC data");
+        }
+        if constexpr (is_floating_point_v<T>) {
+            return (T)numeric_to_double(n);
+        }
+        else {
+            long long v;
+            bool exact;
+            if (!numeric_to_int64(n, v, exact) || v < (long long)numeric_limits<T>::min()
+                || v > (long long)numeric_limits<T>::max()) {
+                throw range_error("NUMERIC value out of range for requested type");
+            }
+            if (!exact) {
+                throw range_error("NUMERIC value has a fractional part");
+            }
+            return (T)v;
+        }
+    }
+
+    // ---------- 榡 ----------
+
+    wstring format_wide(const DataCell& cell) {
+        return cell.get<wstring>();
+    }
+
+    wstring format_narrow(const DataCell& cell) {
+        // SQL_C_CHAR ^O ACP sXAv줸թj|aD ASCII r
+        const vector<BYTE>& buffer = cell.buffer;
+        int n = MultiByteToWideChar(CP_ACP, 0, (const char*)buffer.data(), (int)buffer.size(), nullptr, 0);
+        wstring ws((size_t)max(n, 0), L'\0');
+        MultiByteToWideChar(CP_ACP, 0, (const char*)buffer.data(), (int)buffer.size(), &ws[0], n);
+        ws.append(1, L'\0');
+        return ws;
+    }
+
+    wstring format_date(const DataCell& cell) {
+        if (cell.buffer.size() < sizeof(DATE_STRUCT)) return L"(Invalid DATE)";
+        const DATE_STRUCT* d = (const DATE_STRUCT*)cell.buffer.data();
         SYSTEMTIME st{};
         st.wYear = d->year;
         st.wMonth = d->month;
@@ -95,8 +282,9 @@ wstring DataCell::to_string() const {
         return L"(Invalid DATE)";
     }
 
-    case SQL_TYPE_TIME: {
-        const TIME_STRUCT* t = (const TIME_STRUCT*)buffer.data();
+    wstring format_time(const DataCell& cell) {
+        if (cell.buffer.size() < sizeof(TIME_STRUCT)) return L"(Invalid TIME)";
+        const TIME_STRUCT* t = (const TIME_STRUCT*)cell.buffer.data();
         SYSTEMTIME st{};
         st.wHour = t->hour;
         st.wMinute = t->minute;
@@ -106,8 +294,9 @@ wstring DataCell::to_string() const {
         return L"(Invalid TIME)";
     }
 
-    case SQL_TYPE_TIMESTAMP: {
-        const TIMESTAMP_STRUCT* ts = (const TIMESTAMP_STRUCT*)buffer.data();
+    wstring format_timestamp(const DataCell& cell) {
+        if (cell.buffer.size() < sizeof(TIMESTAMP_STRUCT)) return L"(Invalid TIMESTAMP)";
+        const TIMESTAMP_STRUCT* ts = (const TIMESTAMP_STRUCT*)cell.buffer.data();
         SYSTEMTIME st{};
         st.wYear = ts->year;
         st.wMonth = ts->month;
@@ -128,35 +317,505 @@ wstring DataCell::to_string() const {
         return L"(Invalid TIMESTAMP)";
     }
 
-    case SQL_BINARY:
-    case SQL_VARBINARY:
-    case SQL_LONGVARBINARY:
-    case 98: {
-        wstringstream ss; ss << L"0x" << hex << setfill(L'0');
-        for (BYTE b : buffer) {
-            ss << setw(2) << b;
+    wstring format_binary(const DataCell& cell) {
+        static const wchar_t digits[] = L"0123456789abcdef";
+        wstring out;
+        out.reserve(2 + cell.buffer.size() * 2);
+        out += L"0x";
+        for (BYTE b : cell.buffer) {
+            out.push_back(digits[b >> 4]);
+            out.push_back(digits[b & 0xF]);
         }
-        return ss.str();
+        return out;
     }
 
-    case SQL_INTEGER:
-        return to_wstring(get<int>());
+    template<typename T>
+    wstring format_number(const DataCell& cell) {
+        return to_wstring(cell.get<T>());
+    }
+
+    wstring format_real(const DataCell& cell) {
+        // SQL_REAL H SQL_C_FLOAT ^Au 4 bytes
+        return to_wstring((double)cell.get<float>());
+    }
+
+    wstring format_bit(const DataCell& cell) {
+        return cell.get<unsigned char>() ? L"true" : L"false";
+    }
+
+    wstring format_numeric(const DataCell& cell) {
+        SQL_NUMERIC_STRUCT n;
+        if (!read_numeric(cell, n)) return L"(Invalid NUMERIC)";
+        return numeric_to_wstring(n);
+    }
+
+    wstring format_unsupported(const DataCell&) {
+        return L"(Unsupported Type)";
+    }
+}
+
+namespace {
+    // ǧY cell_codec_id() s
+    enum class CodecId : uint8_t {
+        Unresolved, NarrowText, WideText, TinyInt, SmallInt, Integer, BigInt, Real, Double, Bit, Numeric,
+        Date, Time, Timestamp, Binary, Unsupported, Count
+    };
+
+    const CellCodec codecs[(size_t)CodecId::Count] = {
+        { SQL_C_BINARY, 0, format_unsupported }, // UnresolvedGcell_codec_by_id(0) ub~ήɥX{
+        // r
+        { SQL_C_CHAR, 0, format_narrow },
+        { SQL_C_WCHAR, 0, format_wide },
+        // ƭ
+        { SQL_C_UTINYINT, 1, format_number<unsigned char> },
+        { SQL_C_SSHORT, 2, format_number<short> },
+        { SQL_C_SLONG, 4, format_number<int> },
+        { SQL_C_SBIGINT, 8, format_number<long long> },
+        { SQL_C_FLOAT, 4, format_real },
+        { SQL_C_DOUBLE, 8, format_number<double> },
+        { SQL_C_BIT, 1, format_bit },
+        { SQL_C_NUMERIC, sizeof(SQL_NUMERIC_STRUCT), format_numeric },
+        // ɶ
+        { SQL_C_TYPE_DATE, sizeof(DATE_STRUCT), format_date },
+        { SQL_C_TYPE_TIME, sizeof(TIME_STRUCT), format_time },
+        { SQL_C_TYPE_TIMESTAMP, sizeof(TIMESTAMP_STRUCT), format_timestamp },
+        // Binary / rowversion
+        { SQL_C_BINARY, 0, format_binary },
+        { SQL_C_BINARY, 0, format_unsupported }, // H binary ^AD
+    };
+}
+
+uint8_t SaoFU::cell_codec_id(SQLSMALLINT data_type) {
+    CodecId id;
+    switch (data_type) {
+    case SQL_CHAR:
+    case SQL_VARCHAR:
+    case SQL_LONGVARCHAR:
+        id = CodecId::NarrowText; break;
+    case SQL_WCHAR:
+    case SQL_WVARCHAR:
+    case SQL_WLONGVARCHAR:
+        id = CodecId::WideText; break;
+    case SQL_TINYINT:
+        id = CodecId::TinyInt; break;
     case SQL_SMALLINT:
-        return to_wstring(get<short>());
+        id = CodecId::SmallInt; break;
+    case SQL_INTEGER:
+        id = CodecId::Integer; break;
     case SQL_BIGINT:
-        return to_wstring(get<long long>());
-
-    case SQL_DOUBLE:
-    case SQL_FLOAT:
+        id = CodecId::BigInt; break;
     case SQL_REAL:
-        return to_wstring(get<double>());
+        id = CodecId::Real; break;
+    case SQL_FLOAT:
+    case SQL_DOUBLE:
+        id = CodecId::Double; break;
     case SQL_BIT:
-        return get<unsigned char>() ? L"true" : L"false";
+        id = CodecId::Bit; break;
+    case SQL_NUMERIC:
+    case SQL_DECIMAL:
+        id = CodecId::Numeric; break;
+    case SQL_TYPE_DATE:
+        id = CodecId::Date; break;
+    case SQL_TYPE_TIME:
+        id = CodecId::Time; break;
+    case SQL_TYPE_TIMESTAMP:
+        id = CodecId::Timestamp; break;
+    case SQL_BINARY:
+    case SQL_VARBINARY:
+    case SQL_LONGVARBINARY:
+    case 98: // SQL_ROWVERSION
+        id = CodecId::Binary; break;
     default:
-        return L"(Unsupported Type)";
+        id = CodecId::Unsupported; break;
+    }
+    return (uint8_t)id;
+}
+
+const CellCodec& SaoFU::cell_codec_by_id(uint8_t id) {
+    return codecs[id < (uint8_t)CodecId::Count ? id : (uint8_t)CodecId::Unsupported];
+}
+
+const CellCodec& SaoFU::cell_codec(SQLSMALLINT data_type) {
+    return codecs[cell_codec_id(data_type)];
+}
+
+SQLSMALLINT SaoFU::sql_to_ctype(SQLSMALLINT sql_type) {
+    return cell_codec(sql_type).c_type;
+}
+
+DataCell::DataCell() = default;
+
+DataCell::DataCell(vector<BYTE>&& buf, bool is_null, const ColumnMeta& m): buffer(move(buf)), null_flag(is_null), meta(m) {
+    if (!meta.codec) {
+        meta.codec = cell_codec_id(meta.data_type);
     }
 }
 
+template <typename T>
+T DataCell::get() const {
+    if (!null_flag && (meta.data_type == SQL_NUMERIC || meta.data_type == SQL_DECIMAL)) {
+        return numeric_as<T>(*this);
+    }
+    if (null_flag || buffer.size() < sizeof(T)) {
+        throw runtime_error("Invalid or NULL data for requested type");
+    }
+    return *(const T*)buffer.data();
+}
+
+// LsĶ椸]ϥ get<T>()
+template int DataCell::get<int>() const;
+template short DataCell::get<short>() const;
+template long long DataCell::get<long long>() const;
+template float DataCell::get<float>() const;
+template double DataCell::get<double>() const;
+template unsigned char DataCell::get<unsigned char>() const;
+
+span<const BYTE> DataCell::bytes() const {
+    return { buffer.data(), buffer.size() };
+}
+
+wstring_view DataCell::text() const {
+    if (meta.data_type != SQL_WCHAR && meta.data_type != SQL_WVARCHAR && meta.data_type != SQL_WLONGVARCHAR) {
+        throw runtime_error("DataCell: not a wide text column");
+    }
+    return wstring_view((const wchar_t*)buffer.data(), buffer.size() / sizeof(wchar_t));
+}
+
+const CellCodec& DataCell::codec() const {
+    return meta.codec ? cell_codec_by_id(meta.codec) : cell_codec(meta.data_type);
+}
+
+wstring DataCell::to_string() const {
+    if (null_flag || buffer.empty()) return L"(NULL)";
+    return codec().format(*this);
+}
+
 bool DataCell::is_null() const {
     return null_flag;
-}
\ No newline at end of file
+}
+
+const wstring& FormattedCache::get(const DataTable& table, size_t row, const wstring& column) {
+    auto& columns = rows[row];
+    auto it = columns.find(column);
+    if (it == columns.end()) {
+        it = columns.emplace(column, table.at(row).at(column).to_string()).first;
+    }
+    return it->second;
+}
+
+void FormattedCache::clear() noexcept {
+    rows.clear();
+}
+
+namespace {
+    enum class ValueKind { Integer, Real, Text, WideText, Date, Time, Timestamp, Binary, Numeric };
+
+    ValueKind value_kind(SQLSMALLINT data_type) {
+        switch (data_type) {
+        case SQL_TINYINT:
+        case SQL_SMALLINT:
+        case SQL_INTEGER:
+        case SQL_BIGINT:
+        case SQL_BIT:
+            return ValueKind::Integer;
+        case SQL_REAL:
+        case SQL_FLOAT:
+        case SQL_DOUBLE:
+            return ValueKind::Real;
+        case SQL_NUMERIC:
+        case SQL_DECIMAL:
+            return ValueKind::Numeric;
+        case SQL_CHAR:
+        case SQL_VARCHAR:
+        case SQL_LONGVARCHAR:
+            return ValueKind::Text;
+        case SQL_WCHAR:
+        case SQL_WVARCHAR:
+        case SQL_WLONGVARCHAR:
+            return ValueKind::WideText;
+        case SQL_TYPE_DATE:
+            return ValueKind::Date;
+        case SQL_TYPE_TIME:
+            return ValueKind::Time;
+        case SQL_TYPE_TIMESTAMP:
+            return ValueKind::Timestamp;
+        default:
+            return ValueKind::Binary;
+        }
+    }
+
+    template<typename T>
+    bool read_value(const DataCell& cell, T& out) {
+        if (cell.buffer.size() < sizeof(T)) return false;
+        memcpy(&out, cell.buffer.data(), sizeof(T));
+        return true;
+    }
+
+    int compare_bytes(const vector<BYTE>& a, const vector<BYTE>& b) {
+        size_t n = min(a.size(), b.size());
+        int c = n ? memcmp(a.data(), b.data(), n) : 0;
+        if (c != 0) return c;
+        return a.size() < b.size() ? -1 : (a.size() > b.size() ? 1 : 0);
+    }
+
+    int compare_wide(const vector<BYTE>& a, const vector<BYTE>& b) {
+        const wchar_t* pa = (const wchar_t*)a.data();
+        const wchar_t* pb = (const wchar_t*)b.data();
+        size_t na = a.size() / sizeof(wchar_t);
+        size_t nb = b.size() / sizeof(wchar_t);
+        size_t n = min(na, nb);
+        for (size_t i = 0; i < n; ++i) {
+            if (pa[i] != pb[i]) return pa[i] < pb[i] ? -1 : 1;
+        }
+        return na < nb ? -1 : (na > nb ? 1 : 0);
+    }
+
+    long long timestamp_key(const TIMESTAMP_STRUCT& t) {
+        return ((((long long)t.year * 13 + t.month) * 32 + t.day) * 24 + t.hour) * 3600LL + t.minute * 60LL + t.second;
+    }
+
+    size_t hash_bytes(const void* data, size_t n, size_t seed) {
+        const BYTE* p = (const BYTE*)data;
+        unsigned long long h = 1469598103934665603ull ^ seed;
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+        return (size_t)h;
+    }
+
+    bool is_number(ValueKind kind) {
+        return kind == ValueKind::Integer || kind == ValueKind::Real || kind == ValueKind::Numeric;
+    }
+
+    // NUMERIC PƳন SQL_NUMERIC_STRUCTAɤ
+    bool cell_to_numeric(const DataCell& cell, SQL_NUMERIC_STRUCT& out) {
+        if (value_kind(cell.meta.data_type) == ValueKind::Numeric) {
+            return read_numeric(cell, out);
+        }
+        long long v;
+        if (!cell_to_int64(cell, v)) return false;
+        out = int64_to_numeric(v);
+        return true;
+    }
+
+    //  / NUMERIC  REAL / FLOATGg double ഫAhash_cell() ~P@P
+    bool compare_exact_real(const DataCell& cell, double d, int& out) {
+        long long i;
+        SQL_NUMERIC_STRUCT n;
+        const bool integer = cell_to_int64(cell, i);
+        if (!integer && !cell_to_numeric(cell, n)) return false;
+
+        if (d != d) {
+            out = -1; // NaN ƦbҦƦrAP compare_real() ۦP
+        }
+        else if (isinf(d)) {
+            out = d > 0 ? -1 : 1;
+        }
+        else if (!integer) {
+            out = compare_decimal(decimal_key(n), double_decimal_key(d));
+        }
+        else if (d >= 0x1p63 || d < -0x1p63) {
+            out = d > 0 ? -1 : 1;
+        }
+        else {
+            // |d| < 2^53  d - t OTFj d NO
+            long long t = (long long)d;
+            double fraction = d - (double)t;
+            out = t != i ? three_way(i, t) : (fraction > 0 ? -1 : (fraction < 0 ? 1 : 0));
+        }
+        return true;
+    }
+
+    // NaN 줸u@ءAΤ@P@FƭȪBIƻPۦP
+    size_t hash_real(double d) {
+        if (d != d) return hash_bytes("NaN", 3, (size_t)ValueKind::Real);
+        if (d >= -0x1p63 && d < 0x1p63) {
+            long long i = (long long)d;
+            if ((double)i == d) {
+                return hash_bytes(&i, sizeof(i), (size_t)ValueKind::Integer);
+            }
+        }
+        return hash_bytes(&d, sizeof(d), (size_t)ValueKind::Real);
+    }
+}
+
+bool SaoFU::cell_to_int64(const DataCell& cell, long long& out) {
+    if (cell.null_flag) return false;
+
+    switch (cell.meta.data_type) {
+    case SQL_TINYINT:
+    case SQL_BIT: {
+        unsigned char v;
+        if (!read_value(cell, v)) return false;
+        out = v;
+        return true;
+    }
+    case SQL_SMALLINT: {
+        short v;
+        if (!read_value(cell, v)) return false;
+        out = v;
+        return true;
+    }
+    case SQL_INTEGER: {
+        int v;
+        if (!read_value(cell, v)) return false;
+        out = v;
+        return true;
+    }
+    case SQL_BIGINT:
+        return read_value(cell, out);
+    default:
+        return false;
+    }
+}
+
+bool SaoFU::cell_to_double(const DataCell& cell, double& out) {
+    if (cell.null_flag) return false;
+
+    switch (cell.meta.data_type) {
+    case SQL_REAL: {
+        // SQL_REAL H SQL_C_FLOAT ^Au 4 bytes
+        float v;
+        if (!read_value(cell, v)) return false;
+        out = v;
+        return true;
+    }
+    case SQL_FLOAT:
+    case SQL_DOUBLE:
+        return read_value(cell, out);
+    case SQL_NUMERIC:
+    case SQL_DECIMAL: {
+        SQL_NUMERIC_STRUCT v;
+        if (!read_numeric(cell, v)) return false;
+        out = numeric_to_double(v);
+        return true;
+    }
+    default: {
+        long long i;
+        if (!cell_to_int64(cell, i)) return false;
+        out = (double)i;
+        return true;
+    }
+    }
+}
+
+int SaoFU::compare_cells(const DataCell& a, const DataCell& b) {
+    if (a.null_flag || b.null_flag) {
+        if (a.null_flag && b.null_flag) return 0;
+        return a.null_flag ? -1 : 1;
+    }
+
+    ValueKind ka = value_kind(a.meta.data_type);
+    ValueKind kb = value_kind(b.meta.data_type);
+
+    if (ka == ValueKind::Integer && kb == ValueKind::Integer) {
+        long long x, y;
+        if (cell_to_int64(a, x) && cell_to_int64(b, y)) return three_way(x, y);
+    }
+    else if (ka == ValueKind::Real && kb == ValueKind::Real) {
+        double x, y;
+        if (cell_to_double(a, x) && cell_to_double(b, y)) return compare_real(x, y);
+    }
+    else if (ka == ValueKind::Real && is_number(kb)) {
+        double x;
+        int c;
+        if (cell_to_double(a, x) && compare_exact_real(b, x, c)) return -c;
+    }
+    else if (kb == ValueKind::Real && is_number(ka)) {
+        double y;
+        int c;
+        if (cell_to_double(b, y) && compare_exact_real(a, y, c)) return c;
+    }
+    else if (is_number(ka) && is_number(kb)) {
+        //  NUMERIC ѻPBS REAL / FLOAT
+        SQL_NUMERIC_STRUCT x, y;
+        if (cell_to_numeric(a, x) && cell_to_numeric(b, y)) return compare_decimal(decimal_key(x), decimal_key(y));
+    }
+    else if (ka == kb) {
+        switch (ka) {
+        case ValueKind::WideText:
+            return compare_wide(a.buffer, b.buffer);
+        case ValueKind::Date: {
+            DATE_STRUCT x, y;
+            if (read_value(a, x) && read_value(b, y)) {
+                if (x.year != y.year) return three_way(x.year, y.year);
+                if (x.month != y.month) return three_way(x.month, y.month);
+                return three_way(x.day, y.day);
+            }
+            break;
+        }
+        case ValueKind::Time: {
+            TIME_STRUCT x, y;
+            if (read_value(a, x) && read_value(b, y)) {
+                return three_way(x.hour * 3600 + x.minute * 60 + x.second, y.hour * 3600 + y.minute * 60 + y.second);
+            }
+            break;
+        }
+        case ValueKind::Timestamp: {
+            TIMESTAMP_STRUCT x, y;
+            if (read_value(a, x) && read_value(b, y)) {
+                int c = three_way(timestamp_key(x), timestamp_key(y));
+                return c != 0 ? c : three_way(x.fraction, y.fraction);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // rBGiPLkŪȡG̫Os줸
+    if (ka != kb) return three_way((int)ka, (int)kb);
+    return compare_bytes(a.buffer, b.buffer);
+}
+
+size_t SaoFU::hash_cell(const DataCell& cell) {
+    if (cell.null_flag) return 0x9e3779b9u;
+
+    // ƭȨ̭AP compare_cells() T@PGoi long long ƭȤ@߷ơA
+    // LnY double ȷ doubleANUMERIC ѤUΥWƪQi
+    ValueKind kind = value_kind(cell.meta.data_type);
+    if (kind == ValueKind::Integer) {
+        long long i;
+        if (cell_to_int64(cell, i)) return hash_bytes(&i, sizeof(i), (size_t)ValueKind::Integer);
+    }
+    else if (kind == ValueKind::Real) {
+        double d;
+        if (cell_to_double(cell, d)) return hash_real(d);
+    }
+    else if (kind == ValueKind::Numeric) {
+        SQL_NUMERIC_STRUCT n;
+        if (read_numeric(cell, n)) {
+            long long i;
+            bool exact;
+            if (numeric_to_int64(n, i, exact) && exact) return hash_bytes(&i, sizeof(i), (size_t)ValueKind::Integer);
+            double d;
+            if (numeric_exact_double(n, d)) return hash_real(d);
+            DecimalKey key = decimal_key(n);
+            size_t h = hash_bytes(key.digits.data(), key.digits.size(), (size_t)ValueKind::Numeric + key.negative);
+            return hash_bytes(&key.exponent, sizeof(key.exponent), h);
+        }
+    }
+    return hash_bytes(cell.buffer.data(), cell.buffer.size(), (size_t)kind);
+}
+
+DataCell SaoFU::make_cell(long long v) {
+    ColumnMeta meta{ L"", SQL_BIGINT, 19, 0, SQL_NO_NULLS };
+    vector<BYTE> buf(sizeof(v));
+    memcpy(buf.data(), &v, sizeof(v));
+    return DataCell(move(buf), false, meta);
+}
+
+DataCell SaoFU::make_cell(double v) {
+    ColumnMeta meta{ L"", SQL_DOUBLE, 15, 0, SQL_NO_NULLS };
+    vector<BYTE> buf(sizeof(v));
+    memcpy(buf.data(), &v, sizeof(v));
+    return DataCell(move(buf), false, meta);
+}
+
+DataCell SaoFU::make_cell(const wstring& v) {
+    ColumnMeta meta{ L"", SQL_WVARCHAR, (SQLULEN)v.size(), 0, SQL_NO_NULLS };
+    const BYTE* p = (const BYTE*)v.data();
+    return DataCell(vector<BYTE>(p, p + v.size() * sizeof(wchar_t)), false, meta);
+}
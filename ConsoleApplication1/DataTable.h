@@ -7,15 +7,34 @@
 #include <string>
 #include <vector>
 #include <minwindef.h>
+#include <memory>
+#include <span>
+#include <cstdint>
+#include <string_view>
 #include <unordered_map>
 
 namespace SaoFU {
+    struct DataCell;
+
+    //  data_type Mw^OP榡Ƥ覡FCѪR@AColumnMeta uss
+    struct CellCodec {
+        SQLSMALLINT c_type;                       // SQLGetData ؼЫO
+        std::size_t fixed_size;                   // wO buffer jpAܪ 0
+        std::wstring (*format)(const DataCell&);  // to_string() @ANULL wư
+    };
+
+    const CellCodec& cell_codec(SQLSMALLINT data_type);
+    // ColumnMeta::codec ΪsA0 Odu|ѪRv
+    std::uint8_t cell_codec_id(SQLSMALLINT data_type);
+    const CellCodec& cell_codec_by_id(std::uint8_t id);
+
     struct ColumnMeta {
         std::wstring name;
         SQLSMALLINT data_type;
         SQLULEN column_size;
         SQLSMALLINT decimal_digits;
         SQLSMALLINT nullable;
+        std::uint8_t codec = 0;  // cell_codec_id()Ab padding ̤W[jpF0 ɥ DataCell  data_type ɤW
     };
 
     struct DataCell {
@@ -27,9 +46,18 @@ namespace SaoFU {
 
         DataCell(std::vector<BYTE>&& buf, bool is_null, const ColumnMeta& m);
 
+        // wOŪ bufferFNUMERIC / DECIMAL  scale A
+        // WX T dξƫO|ᱼpƮɥ std::range_error
         template<typename T>
         T get() const;
 
+        // tmO骺˵AĴP buffer ۦP
+        std::span<const BYTE> bytes() const;
+        // uAμerrAt get<std::wstring>() ɪ null
+        std::wstring_view text() const;
+
+        const CellCodec& codec() const;
+
         std::wstring to_string() const;
 
         bool is_null() const;
@@ -42,10 +70,54 @@ namespace SaoFU {
         return ws;
     }
 
+    template<>
+    inline std::wstring_view DataCell::get<std::wstring_view>() const {
+        return text();
+    }
+
     SQLSMALLINT sql_to_ctype(SQLSMALLINT sql_type);
 
+    //  ColumnMeta::data_type Ū bufferAg to_string()
+    // Oũ NULL ɦ^ false
+    bool cell_to_int64(const DataCell& cell, long long& out);
+    bool cell_to_double(const DataCell& cell, double& out);
+
+    // OƤGơBBIƻP NUMERIC ̺TȤ]g double ഫ^ArH code unit ƧǡAɶ
+    // NULL pȡF^ <0 / 0 / >0
+    int compare_cells(const DataCell& a, const DataCell& b);
+    // P compare_cells() == 0 @P
+    std::size_t hash_cell(const DataCell& cell);
+
+    // compare_cells() P TableSort OƤ@ΡA䪺Ǥ~|@P
+    template<typename T>
+    int three_way(const T& a, const T& b) {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+
+    // NaN ƦbҦƦrB۵AƧǮɤ~|}a strict weak ordering
+    inline int compare_real(double a, double b) {
+        bool na = a != a;
+        bool nb = b != b;
+        if (na || nb) return (int)na - (int)nb;
+        return three_way(a, b);
+    }
+
+    // إ߬d߱Ϊ cell]޽dBjoin ^
+    DataCell make_cell(long long v);
+    DataCell make_cell(double v);
+    DataCell make_cell(const std::wstring& v);
+
     using DataRow = std::unordered_map<std::wstring, DataCell>;
     using DataTable = std::vector<DataRow>;
+
+    // to_string() G (C, ) Odb table ~AøsP@檺e
+    // OwFtable eΦCǧLn clear()
+    class FormattedCache {
+        std::unordered_map<std::size_t, std::unordered_map<std::wstring, std::wstring>> rows;
+    public:
+        const std::wstring& get(const DataTable& table, std::size_t row, const std::wstring& column);
+        void clear() noexcept;
+    };
 }
 
 
@@ -10,8 +10,13 @@
 #include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <random>
+#include <thread>
+#include <functional>
 
 #include "DataBaseException.h"
+#include "QueryStats.h"
+#include "Utf8.h"
 
 using namespace SaoFU;
 using namespace std;
@@ -39,9 +44,36 @@ public:
     SQLHSTMT get() const { return h_; }
 };
 
+// 執行期間把 statement 登記到 CancellationToken，結束時解除
+class CancelScope {
+    CancellationToken* token_;
+public:
+    CancelScope(CancellationToken* token, SQLHSTMT h_stmt) : token_(token) {
+        if (token_ && !token_->attach(h_stmt)) {
+            throw QueryTimeoutException(DataBaseException(L"Query cancelled before execution", L"HY008"));
+        }
+    }
+    ~CancelScope() {
+        if (token_) token_->detach();
+    }
+
+    CancelScope(const CancelScope&) = delete;
+    CancelScope& operator=(const CancelScope&) = delete;
+};
+
+// 逾時 / 取消另外丟 QueryTimeoutException，方便呼叫端分開處理
+[[noreturn]] static void throw_statement_error(const wchar_t* message, SQLHSTMT h_stmt) {
+    DataBaseException e(message, h_stmt, SQL_HANDLE_STMT);
+    if (e.sqlstate() == L"HYT00" || e.sqlstate() == L"HY008") {
+        throw QueryTimeoutException(e);
+    }
+    throw e;
+}
+
 
 // 建構函數：順序正確（保留）
-DatabaseAccess::DatabaseAccess() : h_env(nullptr), h_dbc(nullptr), is_connected(false) {
+DatabaseAccess::DatabaseAccess() : h_env(nullptr), h_dbc(nullptr), is_connected(false), query_timeout(0),
+    memory(MemoryTracker::instance().register_connection()) {
     SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &h_env);
     SQLSetEnvAttr(h_env, SQL_ATTR_ODBC_VERSION, (SQLPOINTER)SQL_OV_ODBC3, 0); // 只在這裡設
     SQLAllocHandle(SQL_HANDLE_DBC, h_env, &h_dbc);
@@ -62,7 +94,12 @@ DatabaseAccess::~DatabaseAccess() {
 DatabaseAccess::DatabaseAccess(DatabaseAccess&& other) noexcept :
     h_env(other.h_env),
     h_dbc(other.h_dbc),
-    is_connected(other.is_connected)
+    is_connected(other.is_connected),
+    query_timeout(other.query_timeout),
+    connection_string(move(other.connection_string)),
+    database(move(other.database)),
+    retry_policy(other.retry_policy),
+    memory(move(other.memory))
 {
     other.h_env = nullptr;
     other.h_dbc = nullptr;
@@ -77,6 +114,11 @@ DatabaseAccess& DatabaseAccess::operator=(DatabaseAccess&& other) noexcept {
         h_env = other.h_env;
         h_dbc = other.h_dbc;
         is_connected = other.is_connected;
+        query_timeout = other.query_timeout;
+        connection_string = move(other.connection_string);
+        database = move(other.database);
+        retry_policy = other.retry_policy;
+        memory = move(other.memory);
 
         // 將來源清空，避免重複釋放
         other.h_env = nullptr;
@@ -101,11 +143,14 @@ bool DatabaseAccess::connect(const wstring& connection_str) {
 
     if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
         is_connected = true;
+        connection_string = connection_str;
         wcout << L"Connected to database successfully!\n";
         return true;
     }
     else {
-        throw DataBaseException(L"Failed to connect to database.\n", h_dbc, SQL_HANDLE_DBC);
+        DataBaseException e(L"Failed to connect to database.\n", h_dbc, SQL_HANDLE_DBC);
+        e.log();
+        throw e;
     }
 }
 
@@ -126,10 +171,13 @@ DatabaseAccess&& DatabaseAccess::connect(const wstring& server, const wstring& u
 
     if (ret == SQL_SUCCESS || ret == SQL_SUCCESS_WITH_INFO) {
         is_connected = true;
+        connection_string = cs;
         wcout << L"Connected to database successfully!\n";
     }
     else {
-        throw DataBaseException(L"Failed to connect to database.\n", h_dbc, SQL_HANDLE_DBC);
+        DataBaseException e(L"Failed to connect to database.\n", h_dbc, SQL_HANDLE_DBC);
+        e.log();
+        throw e;
     }
 
     return move(*this);
@@ -140,9 +188,72 @@ DatabaseAccess&& DatabaseAccess::set_database(const wstring& database) {
     wstring useDb = L"USE " + database;
     StmtHandle h_stmt(h_dbc);
     SQLExecDirectW(h_stmt, (SQLWCHAR*)useDb.c_str(), SQL_NTS);
+    this->database = database;
+    if (memory) memory->set_database(database);
+    return move(*this);
+}
+
+DatabaseAccess&& DatabaseAccess::set_query_timeout(chrono::seconds timeout) {
+    query_timeout = (SQLULEN)max<long long>(timeout.count(), 0);
+    return move(*this);
+}
+
+DatabaseAccess&& DatabaseAccess::set_retry_policy(const RetryPolicy& policy) {
+    retry_policy = policy;
+    return move(*this);
+}
+
+DatabaseAccess&& DatabaseAccess::set_memory_limits(const MemoryLimits& limits) {
+    if (memory) memory->set_limits(limits);
     return move(*this);
 }
 
+chrono::milliseconds RetryPolicy::delay_for(int attempt) const {
+    thread_local mt19937_64 rng{ random_device{}() };
+
+    long long cap = base_delay.count();
+    for (int i = 1; i < attempt && cap < max_delay.count(); ++i) {
+        cap *= 2;
+    }
+    cap = min(cap, (long long)max_delay.count());
+    if (cap <= 0) return chrono::milliseconds(0);
+
+    uniform_int_distribution<long long> dist(0, cap);
+    return chrono::milliseconds(dist(rng));
+}
+
+bool DatabaseAccess::connection_dead() const {
+    SQLUINTEGER dead = SQL_CD_FALSE;
+    SQLRETURN ret = SQLGetConnectAttr(h_dbc, SQL_ATTR_CONNECTION_DEAD, &dead, SQL_IS_UINTEGER, nullptr);
+    return SQL_SUCCEEDED(ret) && dead == SQL_CD_TRUE;
+}
+
+void DatabaseAccess::reconnect() const {
+    if (connection_string.empty()) {
+        throw DataBaseException(L"reconnect() called before connect()", L"08003");
+    }
+
+    if (is_connected) {
+        SQLDisconnect(h_dbc);
+        is_connected = false;
+    }
+
+    SQLRETURN ret = SQLDriverConnect(h_dbc, NULL, (SQLWCHAR*)connection_string.c_str(), SQL_NTS,
+        nullptr, 0, nullptr, SQL_DRIVER_NOPROMPT);
+    if (!SQL_SUCCEEDED(ret)) {
+        throw DataBaseException(L"Failed to reconnect to database.", h_dbc, SQL_HANDLE_DBC);
+    }
+    is_connected = true;
+
+    if (!database.empty()) {
+        wstring useDb = L"USE " + database;
+        StmtHandle h_stmt(h_dbc);
+        if (!SQL_SUCCEEDED(SQLExecDirectW(h_stmt, (SQLWCHAR*)useDb.c_str(), SQL_NTS))) {
+            throw DataBaseException(L"Failed to restore database after reconnect.", h_stmt, SQL_HANDLE_STMT);
+        }
+    }
+}
+
 SaoFU::DataTable DatabaseAccess::procedure(const std::wstring& procedure_name) const {
     std::wostringstream out;
     out << L"\n" << "EXEC " << procedure_name << " ";
@@ -153,110 +264,391 @@ SaoFU::DataTable DatabaseAccess::procedure(const std::wstring& procedure_name) c
 
 // **執行 SQL 指令**
 DataTable DatabaseAccess::command(const wstring& query, const initializer_list<wstring>& params) const {
-    StmtHandle h_stmt(h_dbc);
+    return command(query, QueryOptions{}, params);
+}
+
+DataTable DatabaseAccess::command(const wstring& query, const QueryOptions& options, const initializer_list<wstring>& params) const {
+    DataTable table;
+    MemoryReservation reservation(memory.get());
+    run_with_retry(options, [&](bool& executed) {
+        table.clear(); // 重試時捨棄上一次取回的部分結果
+        reservation.release();
+        execute(query, options, { params.begin(), params.size() }, [&](DataRow&& row) {
+            reservation.add(memory_usage(row).total());
+            table.emplace_back(move(row));
+        }, executed);
+    });
+    return table;
+}
+
+SpillableTable DatabaseAccess::command_spill(const wstring& query, size_t memory_budget, const QueryOptions& options,
+                                             const initializer_list<wstring>& params) const {
+    SpillableTable table(memory_budget);
+    MemoryReservation reservation(memory.get());
+    run_with_retry(options, [&](bool& executed) {
+        table = SpillableTable(memory_budget);
+        reservation.release();
+        execute(query, options, { params.begin(), params.size() }, [&](DataRow&& row) {
+            // 只計留在記憶體中的列，溢出到暫存檔的不算
+            size_t before = table.stats().in_memory_bytes;
+            table.append(move(row));
+            reservation.add(table.stats().in_memory_bytes - before);
+        }, executed);
+    });
+    table.finish();
+    return table;
+}
+
+EncodedTable DatabaseAccess::command_encoded(const wstring& query, const EncodingOptions& encoding, const QueryOptions& options,
+                                             const initializer_list<wstring>& params) const {
+    EncodedTable table(encoding);
+    MemoryReservation reservation(memory.get());
+    run_with_retry(options, [&](bool& executed) {
+        table = EncodedTable(encoding);
+        reservation.release();
+        execute(query, options, { params.begin(), params.size() }, [&](DataRow&& row) {
+            reservation.add(table.append(move(row)));
+        }, executed);
+    });
+    return table;
+}
 
-    // 1) Prepare：使用 '?' 位置參數
-    if (!SQL_SUCCEEDED(SQLPrepareW(h_stmt, (SQLWCHAR*)query.c_str(), SQL_NTS))) {
-        throw DataBaseException(L"SQLPrepareW failed", h_stmt, SQL_HANDLE_STMT);
+PrefetchReader DatabaseAccess::command_prefetch(const wstring& query, const PrefetchOptions& prefetch, const QueryOptions& options,
+                                                const initializer_list<wstring>& params) const {
+    // stop() 與解構只會取消 reader 自己的 token；呼叫端的 token 不會掛上 statement，取消不到也等不到
+    if (options.cancel) {
+        throw DataBaseException(L"command_prefetch() is cancelled through PrefetchReader::stop(), not QueryOptions::cancel", L"HY024");
     }
+    // initializer_list 只活到這次呼叫結束，背景執行緒用自己的副本
+    return PrefetchReader([this, query, options, owned = vector<wstring>(params)](const RowSink& sink, CancellationToken& cancel) {
+        QueryOptions fetch_options = options;
+        fetch_options.idempotent = false;
+        fetch_options.cancel = &cancel;
+        run_with_retry(fetch_options, [&](bool& executed) {
+            execute(query, fetch_options, owned, sink, executed);
+        });
+    }, prefetch);
+}
 
-    // 2) 綁定所有參數
-    vector<SQLLEN> ind(params.size(), SQL_NTS);
-    SQLUSMALLINT i = 0;
-    for (const auto& row : params) {
-        SQLRETURN ret = SQLBindParameter(
-            h_stmt,
-            (SQLUSMALLINT)(i + 1),
-            SQL_PARAM_INPUT,
-            SQL_C_WCHAR,
-            SQL_WVARCHAR,
-            (SQLULEN)max<size_t>(row.size(), 1),
-            0,
-            (SQLPOINTER)row.c_str(),
-            0,
-            &ind[i]
-        );
+Utf8Table DatabaseAccess::command_utf8(const string& query, const initializer_list<string>& params) const {
+    return command_utf8(query, QueryOptions{}, params);
+}
 
-        if (!SQL_SUCCEEDED(ret)) {
-            throw DataBaseException(L"SQLBindParameter failed", h_stmt, SQL_HANDLE_STMT);
+Utf8Table DatabaseAccess::command_utf8(const string& query, const QueryOptions& options, const initializer_list<string>& params) const {
+    Utf8Table table;
+    MemoryReservation reservation(memory.get());
+    run_with_retry(options, [&](bool& executed) {
+        table.clear();
+        reservation.release();
+        execute_utf8(query, options, params, [&](Utf8Row&& row) {
+            reservation.add(memory_usage(row).total());
+            table.emplace_back(move(row));
+        }, executed);
+    });
+    return table;
+}
+
+// 暫時性錯誤依 retry_policy 重試；連線已斷時一律先重連，讓後續呼叫不必再等
+void DatabaseAccess::run_with_retry(const QueryOptions& options, const function<void(bool& executed)>& attempt_once) const {
+    for (int attempt = 1;; ++attempt) {
+        bool executed = false;
+        try {
+            if (!is_connected && !connection_string.empty()) {
+                reconnect();
+            }
+            attempt_once(executed);
+            return;
+        }
+        catch (const DataBaseException& e) {
+            if (is_connected && !connection_string.empty() && (e.is_connection_error() || connection_dead())) {
+                try {
+                    reconnect();
+                }
+                catch (const DataBaseException&) {
+                    is_connected = false; // 下一次嘗試時再連
+                }
+            }
+
+            bool replayable = options.idempotent || !executed;
+            bool cancelled = options.cancel && options.cancel->is_cancelled();
+            bool retryable = e.is_transient() && (retry_policy.retry_timeouts || !e.is_timeout());
+            if (!retryable || !replayable || cancelled || attempt >= retry_policy.max_attempts) {
+                e.log();
+                throw;
+            }
+            this_thread::sleep_for(retry_policy.delay_for(attempt));
         }
-        ++i; // 綁定完再遞增，避免 off-by-one
     }
+}
 
-    // 3) 執行
-    if (!SQL_SUCCEEDED(SQLExecute(h_stmt))) {
-        throw DataBaseException(L"SQLExecute failed", h_stmt, SQL_HANDLE_STMT);
+// 依 ODBC 分段取回：被截斷時從已寫入的位置接續呼叫 SQLGetData，直到拿完為止
+// scratch 在整個查詢中重複使用，回傳 false 表示 NULL
+static bool fetch_cell(SQLHSTMT h_stmt, SQLUSMALLINT col, SQLSMALLINT ctype, vector<BYTE>& scratch,
+                       size_t& size, QueryTrace& trace) {
+    const size_t terminator = ctype == SQL_C_WCHAR ? sizeof(SQLWCHAR) : (ctype == SQL_C_CHAR ? 1 : 0);
+    size = 0;
+
+    for (;;) {
+        size_t avail = scratch.size() - size;
+        SQLLEN len = 0;
+        SQLRETURN rc = SQLGetData(h_stmt, col, ctype, scratch.data() + size, (SQLLEN)avail, &len);
+        if (rc == SQL_NO_DATA) {
+            return true;
+        }
+        if (!SQL_SUCCEEDED(rc)) {
+            throw_statement_error(L"SQLGetData failed", h_stmt);
+        }
+        if (len == SQL_NULL_DATA) {
+            return false;
+        }
+
+        if (rc == SQL_SUCCESS || (len != SQL_NO_TOTAL && (size_t)len + terminator <= avail)) {
+            size += (len == SQL_NO_TOTAL) ? avail - terminator : (size_t)len;
+            return true;
+        }
+
+        // 截斷：這次寫入 avail - terminator 個位元組，剩下的長度由 len 得知（未知時加倍）
+        size += avail - terminator;
+        size_t remaining = (len == SQL_NO_TOTAL) ? scratch.size() : (size_t)len - (avail - terminator);
+        scratch.resize(size + remaining + terminator);
+        trace.add_refetch();
     }
+}
 
+static vector<ColumnMeta> describe_columns(SQLHSTMT h_stmt) {
     vector<ColumnMeta> col_meta;
-    DataTable table;
 
     SQLSMALLINT col_count = 0;
     SQLNumResultCols(h_stmt, &col_count);
 
-    if (col_count > 0) {
-        // 欄位描述
-        for (SQLUSMALLINT col = 1; col <= col_count; ++col) {
-            SQLWCHAR col_name[128] = {};
-            ColumnMeta meta{};
-            SQLDescribeColW(
-                h_stmt,
-                col,
-                col_name,
-                sizeof(col_name) / sizeof(SQLWCHAR),
-                nullptr,
-                &meta.data_type,
-                &meta.column_size,
-                &meta.decimal_digits,
-                &meta.nullable
-            );
+    for (SQLUSMALLINT col = 1; col <= col_count; ++col) {
+        SQLWCHAR col_name[128] = {};
+        ColumnMeta meta{};
+        SQLDescribeColW(
+            h_stmt,
+            col,
+            col_name,
+            sizeof(col_name) / sizeof(SQLWCHAR),
+            nullptr,
+            &meta.data_type,
+            &meta.column_size,
+            &meta.decimal_digits,
+            &meta.nullable
+        );
+
+        meta.name = wstring(col_name);
+        meta.codec = cell_codec_id(meta.data_type);
+        col_meta.push_back(meta);
+    }
+    return col_meta;
+}
 
-            meta.name = wstring(col_name);
-            col_meta.push_back(meta);
+// SQLGetData 以 SQL_C_NUMERIC 取回時用的是 ARD 上的 precision 與 scale，預設 scale 為 0 會截掉小數
+// 所以先把欄位的 precision / scale 寫進 ARD，再以 SQL_ARD_TYPE 取回；設定失敗時退回 SQL_C_NUMERIC
+static vector<SQLSMALLINT> fetch_ctypes(SQLHSTMT h_stmt, const vector<ColumnMeta>& col_meta) {
+    vector<SQLSMALLINT> ctypes;
+    SQLHDESC ard = nullptr;
+    for (size_t i = 0; i < col_meta.size(); ++i) {
+        const ColumnMeta& meta = col_meta[i];
+        SQLSMALLINT ctype = cell_codec_by_id(meta.codec).c_type;
+        if (ctype == SQL_C_NUMERIC) {
+            if (!ard) {
+                SQLGetStmtAttr(h_stmt, SQL_ATTR_APP_ROW_DESC, &ard, 0, nullptr);
+            }
+            SQLUSMALLINT col = (SQLUSMALLINT)(i + 1);
+            if (ard
+                && SQL_SUCCEEDED(SQLSetDescField(ard, col, SQL_DESC_TYPE, (SQLPOINTER)(SQLLEN)SQL_C_NUMERIC, 0))
+                && SQL_SUCCEEDED(SQLSetDescField(ard, col, SQL_DESC_PRECISION, (SQLPOINTER)(SQLLEN)meta.column_size, 0))
+                && SQL_SUCCEEDED(SQLSetDescField(ard, col, SQL_DESC_SCALE, (SQLPOINTER)(SQLLEN)meta.decimal_digits, 0))) {
+                ctype = SQL_ARD_TYPE;
+            }
         }
+        ctypes.push_back(ctype);
+    }
+    return ctypes;
+}
+
+// execute() 與 execute_utf8() 共用的 statement 生命週期：配置 handle、逾時、取消、prepare、執行、逐列取回
+// prepare 負責 SQLPrepare 與綁定參數，綁定的緩衝區由呼叫端持有到這裡回傳為止
+// describe 在執行後拿到欄位資訊，回傳每次 SQLFetch 成功後讀取一列的函式
+using PrepareStep = function<void(SQLHSTMT h_stmt)>;
+using RowReader = function<void(vector<BYTE>& scratch, QueryTrace& trace)>;
+using DescribeStep = function<RowReader(SQLHSTMT h_stmt, const vector<ColumnMeta>& col_meta)>;
+
+// trace 由呼叫端依語句的編碼建立，execute_utf8() 在 UTF-8 ACP 下不必為了統計 key 轉成 UTF-16
+static void run_statement(SQLHDBC h_dbc, SQLULEN default_timeout, QueryTrace& trace, const QueryOptions& options,
+                          const PrepareStep& prepare, const DescribeStep& describe, bool& executed) {
+    StmtHandle h_stmt(h_dbc);
+    CancelScope cancel_scope(options.cancel, h_stmt);
+
+    SQLULEN timeout = options.timeout.count() > 0 ? (SQLULEN)options.timeout.count() : default_timeout;
+    if (timeout > 0) {
+        SQLSetStmtAttr(h_stmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER)timeout, SQL_IS_UINTEGER);
+    }
 
+    // 1) Prepare 並綁定參數：使用 '?' 位置參數
+    prepare(h_stmt);
+    trace.mark(QueryPhase::Prepare);
+
+    // 2) 執行
+    executed = true;
+    if (!SQL_SUCCEEDED(SQLExecute(h_stmt))) {
+        throw_statement_error(L"SQLExecute failed", h_stmt);
+    }
+    trace.mark(QueryPhase::Execute);
+
+    // 3) 逐列取回
+    vector<ColumnMeta> col_meta = describe_columns(h_stmt);
+    if (!col_meta.empty()) {
+        RowReader read_row = describe(h_stmt, col_meta);
+        trace.mark(QueryPhase::Describe);
+
+        vector<BYTE> scratch(128);
         SQLRETURN frc;
         while ((frc = SQLFetch(h_stmt)) != SQL_NO_DATA) {
-            if (!SQL_SUCCEEDED(frc) && frc != SQL_SUCCESS_WITH_INFO) {
-                break;
+            if (!SQL_SUCCEEDED(frc)) {
+                throw_statement_error(L"SQLFetch failed", h_stmt);
             }
+            read_row(scratch, trace);
+            trace.add_row();
+        }
+        trace.mark(QueryPhase::Fetch);
+    }
 
-            DataRow row;
-            for (SQLUSMALLINT col = 1; col <= col_count; ++col) {
-                SQLLEN len = 0;
-                vector<BYTE> buf(128, '\0');
+    trace.finish();
+}
+
+void DatabaseAccess::execute(const wstring& query, const QueryOptions& options, span<const wstring> params,
+                             const RowSink& on_row, bool& executed) const {
+    vector<SQLLEN> ind(params.size(), SQL_NTS);
+
+    auto prepare = [&](SQLHSTMT h_stmt) {
+        if (!SQL_SUCCEEDED(SQLPrepareW(h_stmt, (SQLWCHAR*)query.c_str(), SQL_NTS))) {
+            throw_statement_error(L"SQLPrepareW failed", h_stmt);
+        }
 
+        SQLUSMALLINT i = 0;
+        for (const auto& row : params) {
+            SQLRETURN ret = SQLBindParameter(
+                h_stmt,
+                (SQLUSMALLINT)(i + 1),
+                SQL_PARAM_INPUT,
+                SQL_C_WCHAR,
+                SQL_WVARCHAR,
+                (SQLULEN)max<size_t>(row.size(), 1),
+                0,
+                (SQLPOINTER)row.c_str(),
+                0,
+                &ind[i]
+            );
+
+            if (!SQL_SUCCEEDED(ret)) {
+                throw DataBaseException(L"SQLBindParameter failed", h_stmt, SQL_HANDLE_STMT);
+            }
+            ++i; // 綁定完再遞增，避免 off-by-one
+        }
+    };
+
+    auto describe = [&](SQLHSTMT h_stmt, const vector<ColumnMeta>& col_meta) -> RowReader {
+        return [&, h_stmt, ctypes = fetch_ctypes(h_stmt, col_meta)](vector<BYTE>& scratch, QueryTrace& trace) {
+            DataRow row;
+            for (SQLUSMALLINT col = 1; col <= (SQLUSMALLINT)col_meta.size(); ++col) {
                 const ColumnMeta& meta = col_meta[col - 1];
-                SQLSMALLINT ctype = sql_to_ctype(meta.data_type);
-                SQLRETURN rc = SQLGetData(h_stmt, col, ctype, buf.data(), (SQLLEN)buf.size(), &len);
-                DataCell cell;
-
-                bool is_success = (rc == SQL_SUCCESS || rc == SQL_SUCCESS_WITH_INFO);
-                if (is_success && len == SQL_NULL_DATA) {
-                    cell = DataCell({}, true, meta);
-                    row.emplace(meta.name, move(cell));
+                size_t size = 0;
+                if (!fetch_cell(h_stmt, col, ctypes[col - 1], scratch, size, trace)) {
+                    row.emplace(meta.name, DataCell({}, true, meta));
                     continue;
                 }
 
-                if (is_success && len != SQL_NO_TOTAL && len > (SQLLEN)buf.size()) {
-                    buf.resize((size_t)len);
-                    rc = SQLGetData(h_stmt, col, ctype, buf.data(), (SQLLEN)buf.size(), &len);
-                }
+                trace.add_bytes(size);
+                row.emplace(meta.name, DataCell(vector<BYTE>(scratch.begin(), scratch.begin() + size), false, meta));
+            }
+            on_row(move(row));
+        };
+    };
+
+    QueryTrace trace(query);
+    run_statement(h_dbc, query_timeout, trace, options, prepare, describe, executed);
+}
+
+// ACP 為 UTF-8 時語句、參數與文字欄都走 A 版本 / SQL_C_CHAR，完全不轉碼
+// 否則在邊界轉一次：語句與參數轉成 UTF-16，文字欄以 SQL_C_WCHAR 取回後轉成 UTF-8
+void DatabaseAccess::execute_utf8(const string& query, const QueryOptions& options, const initializer_list<string>& params,
+                                  const function<void(Utf8Row&&)>& on_row, bool& executed) const {
+    const bool utf8_acp = GetACP() == CP_UTF8;
+    // 只有走 SQLPrepareW 時才需要 UTF-16 語句；統計 key 由 QueryStats 以 UTF-8 原文快取
+    wstring wide_query;
+
+    // 綁定的緩衝區要活到 SQLExecute 之後
+    vector<wstring> wide_params;
+    if (!utf8_acp) {
+        wide_query = utf8_to_wide(query);
+        wide_params.reserve(params.size());
+        for (const auto& p : params) {
+            wide_params.push_back(utf8_to_wide(p));
+        }
+    }
+    vector<SQLLEN> ind(params.size(), SQL_NTS);
+
+    auto prepare = [&](SQLHSTMT h_stmt) {
+        SQLRETURN prc = utf8_acp
+            ? SQLPrepareA(h_stmt, (SQLCHAR*)query.c_str(), SQL_NTS)
+            : SQLPrepareW(h_stmt, (SQLWCHAR*)wide_query.c_str(), SQL_NTS);
+        if (!SQL_SUCCEEDED(prc)) {
+            throw_statement_error(L"SQLPrepare failed", h_stmt);
+        }
 
-                if (len >= 0 && len <= (SQLLEN)buf.size()) {
-                    cell = DataCell(vector<BYTE>(buf.begin(), buf.begin() + len), false, meta);
+        SQLUSMALLINT i = 0;
+        for (const auto& p : params) {
+            // 目標一律 SQL_WVARCHAR，讓 driver 從 client 編碼轉成 Unicode，不受資料庫定序影響
+            SQLRETURN ret = utf8_acp
+                ? SQLBindParameter(h_stmt, (SQLUSMALLINT)(i + 1), SQL_PARAM_INPUT, SQL_C_CHAR, SQL_WVARCHAR,
+                                   (SQLULEN)max<size_t>(p.size(), 1), 0, (SQLPOINTER)p.c_str(), 0, &ind[i])
+                : SQLBindParameter(h_stmt, (SQLUSMALLINT)(i + 1), SQL_PARAM_INPUT, SQL_C_WCHAR, SQL_WVARCHAR,
+                                   (SQLULEN)max<size_t>(wide_params[i].size(), 1), 0, (SQLPOINTER)wide_params[i].c_str(), 0, &ind[i]);
+            if (!SQL_SUCCEEDED(ret)) {
+                throw DataBaseException(L"SQLBindParameter failed", h_stmt, SQL_HANDLE_STMT);
+            }
+            ++i;
+        }
+    };
+
+    auto describe = [&](SQLHSTMT h_stmt, const vector<ColumnMeta>& col_meta) -> RowReader {
+        vector<string> names;
+        vector<SQLSMALLINT> ctypes = fetch_ctypes(h_stmt, col_meta);
+        for (size_t i = 0; i < col_meta.size(); ++i) {
+            names.push_back(wide_to_utf8(col_meta[i].name));
+            if (is_text_type(col_meta[i].data_type)) {
+                ctypes[i] = utf8_acp ? SQL_C_CHAR : SQL_C_WCHAR;
+            }
+        }
+
+        return [&, h_stmt, names = move(names), ctypes = move(ctypes)](vector<BYTE>& scratch, QueryTrace& trace) {
+            Utf8Row row;
+            row.reserve(col_meta.size());
+            for (SQLUSMALLINT col = 1; col <= (SQLUSMALLINT)col_meta.size(); ++col) {
+                Utf8Cell cell;
+                cell.data_type = col_meta[col - 1].data_type;
+
+                size_t size = 0;
+                if (!fetch_cell(h_stmt, col, ctypes[col - 1], scratch, size, trace)) {
+                    cell.null_flag = true;
+                }
+                else if (ctypes[col - 1] == SQL_C_WCHAR) {
+                    wide_to_utf8(wstring_view((const wchar_t*)scratch.data(), size / sizeof(wchar_t)), cell.data);
                 }
                 else {
-                    cell = DataCell(move(buf), false, meta);
+                    cell.data.assign((const char*)scratch.data(), size);
                 }
-
-                row.emplace(meta.name, move(cell));
+                trace.add_bytes(size);
+                row.emplace(names[col - 1], move(cell));
             }
-            table.emplace_back(move(row));
-        }
-    }
+            on_row(move(row));
+        };
+    };
 
-    return table;
+    QueryTrace trace(query);
+    run_statement(h_dbc, query_timeout, trace, options, prepare, describe, executed);
 }
 
 
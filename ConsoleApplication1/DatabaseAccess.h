@@ -5,9 +5,19 @@
 #include <iomanip>
 #include <windows.h>
 #include <sqlext.h> 
+#include <chrono>
+#include <functional>
+#include <span>
 #include <string>
 
+#include "CancellationToken.h"
 #include "DataTable.h"
+#include "EncodedTable.h"
+#include "MemoryAccounting.h"
+#include "PrefetchReader.h"
+#include "QueryStats.h"
+#include "SpillableTable.h"
+#include "Utf8.h"
 
 #include <sstream>
 
@@ -50,6 +60,29 @@ namespace SaoFU {
 
     template<> struct SqlTypeName<SQLCMD> { static constexpr const wchar_t* value = L"nvarchar(max)"; };
 
+    // 單次 command() 的選項
+    struct QueryOptions {
+        // SQL_ATTR_QUERY_TIMEOUT，單位秒；0 表示沿用連線的 set_query_timeout()
+        std::chrono::seconds timeout{ 0 };
+        // 非 nullptr 時，其他執行緒可透過它 SQLCancel 這次查詢
+        CancellationToken* cancel = nullptr;
+        // 重複執行不會有副作用時設為 true，暫時性錯誤後才會在 SQLExecute 之後重送
+        bool idempotent = false;
+    };
+
+    // 暫時性錯誤（見 DataBaseException::is_transient）的重試策略，指數退避加 full jitter
+    struct RetryPolicy {
+        int max_attempts = 3; // 含第一次，1 表示不重試
+        std::chrono::milliseconds base_delay{ 200 };
+        std::chrono::milliseconds max_delay{ 5000 };
+        // 查詢逾時（HYT00）也重試；每次都會再等滿 timeout，最多等 max_attempts 倍，所以預設關閉
+        bool retry_timeouts = false;
+
+        std::chrono::milliseconds delay_for(int attempt) const;
+    };
+
+    using RowSink = std::function<void(DataRow&&)>;
+
 
     template<typename T>
     std::wstring emit_value(const T& v) {
@@ -100,13 +133,35 @@ class DatabaseAccess {
 private:
     SQLHENV h_env;
     SQLHDBC h_dbc;
-    bool is_connected;
+    mutable bool is_connected; // command() 斷線重連時會更新
+    SQLULEN query_timeout;
+    std::wstring connection_string;
+    std::wstring database;
+    SaoFU::RetryPolicy retry_policy;
+    std::shared_ptr<SaoFU::ConnectionMemory> memory; // 這條連線組裝中結果的計數，見 MemoryAccounting.h
+
+    // 執行一次查詢，每取回一列就交給 on_row；executed 表示是否已送出 SQLExecute
+    void execute(const std::wstring& query, const SaoFU::QueryOptions& options,
+                 std::span<const std::wstring> params, const SaoFU::RowSink& on_row, bool& executed) const;
+    void execute_utf8(const std::string& query, const SaoFU::QueryOptions& options,
+                      const std::initializer_list<std::string>& params,
+                      const std::function<void(SaoFU::Utf8Row&&)>& on_row, bool& executed) const;
+    void run_with_retry(const SaoFU::QueryOptions& options, const std::function<void(bool& executed)>& attempt) const;
+    bool connection_dead() const;
 public:
     DatabaseAccess();
     bool connect(const std::wstring& connection_str);
     DatabaseAccess&& connect(const std::wstring& server, const std::wstring& uid,
                              const std::wstring& pwd);
     DatabaseAccess&& set_database(const std::wstring& database);
+    // 此連線上所有查詢的預設逾時，0 表示不限制
+    DatabaseAccess&& set_query_timeout(std::chrono::seconds timeout);
+    DatabaseAccess&& set_retry_policy(const SaoFU::RetryPolicy& policy);
+    // 這條連線上單次結果的 soft / hard 上限；行程整體的上限用 MemoryTracker::instance().set_limits()
+    DatabaseAccess&& set_memory_limits(const SaoFU::MemoryLimits& limits);
+
+    // 用上次 connect() 的連線字串重新連線並切回 set_database() 的資料庫，失敗時丟 DataBaseException
+    void reconnect() const;
 
     SaoFU::DataTable procedure(const std::wstring& procedure_name) const;
 
@@ -173,6 +228,29 @@ public:
     }
 
     SaoFU::DataTable command(const std::wstring& query, const std::initializer_list<std::wstring>& params = {}) const;
+    SaoFU::DataTable command(const std::wstring& query, const SaoFU::QueryOptions& options,
+                             const std::initializer_list<std::wstring>& params = {}) const;
+    // 與 command() 相同，但語句、參數、欄名與文字欄都是 UTF-8，見 Utf8.h
+    // 行程的 ACP 為 UTF-8（例如 manifest 的 activeCodePage）時全程走 SQLPrepareA / SQL_C_CHAR，不經過 wchar_t
+    SaoFU::Utf8Table command_utf8(const std::string& query, const std::initializer_list<std::string>& params = {}) const;
+    SaoFU::Utf8Table command_utf8(const std::string& query, const SaoFU::QueryOptions& options,
+                                  const std::initializer_list<std::string>& params = {}) const;
+    // 結果估計超過 memory_budget 位元組後，之後的列溢出到暫存檔，見 SpillableTable.h
+    SaoFU::SpillableTable command_spill(const std::wstring& query, std::size_t memory_budget,
+                                        const SaoFU::QueryOptions& options = {},
+                                        const std::initializer_list<std::wstring>& params = {}) const;
+    // 低基數的 NVARCHAR / NCHAR 欄在取回時轉成 dictionary code，見 EncodedTable.h
+    SaoFU::EncodedTable command_encoded(const std::wstring& query, const SaoFU::EncodingOptions& encoding,
+                                        const SaoFU::QueryOptions& options = {},
+                                        const std::initializer_list<std::wstring>& params = {}) const;
+    // 背景執行緒 SQLFetch 到 PrefetchReader 的區塊 ring，消費端處理的同時下一塊已在取，見 PrefetchReader.h
+    // reader 讀完或 stop() 之前這條連線被它佔用，也不能比 DatabaseAccess 活得久
+    // 已交出列之後不會重送，options.idempotent 在這裡不生效
+    // 取消一律透過 PrefetchReader::stop()；options.cancel 不為 nullptr 時丟出 DataBaseException（HY024）
+    // 區塊 ring 的大小固定，不計入 memory_stats()
+    SaoFU::PrefetchReader command_prefetch(const std::wstring& query, const SaoFU::PrefetchOptions& prefetch,
+                                           const SaoFU::QueryOptions& options = {},
+                                           const std::initializer_list<std::wstring>& params = {}) const;
 
     template<typename... Ts>
     SaoFU::DataTable command(const std::wstring& procedure_name, std::wstring param_name, Ts&&... ts) const {
@@ -192,6 +270,15 @@ public:
         return command(exec_query);
     }
 
+    // 各正規化語句的延遲直方圖與計數快照，見 QueryStats.h
+    static std::vector<SaoFU::StatementSnapshot> stats() {
+        return SaoFU::QueryStats::instance().stats();
+    }
+    // 行程與各連線的結果記憶體（live / peak / 超過上限次數），見 MemoryAccounting.h
+    static SaoFU::MemoryStats memory_stats() {
+        return SaoFU::MemoryTracker::instance().stats();
+    }
+
     void disconnect();
     ~DatabaseAccess();
 
@@ -13,7 +13,7 @@ std::wstring SaoFU::emit_value(const std::vector<std::uint8_t>& data) {
     std::wostringstream os;
     os << L"0x" << std::uppercase << std::hex << std::setfill(L'0');
     for (auto b : data) {
-        os << std::setw(2) << b;
+        os << std::setw(2) << static_cast<unsigned>(b);
     }
     return os.str();
 }
@@ -0,0 +1,211 @@
+﻿#include "EncodedTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    bool is_wide_text(SQLSMALLINT data_type) {
+        return data_type == SQL_WCHAR || data_type == SQL_WVARCHAR || data_type == SQL_WLONGVARCHAR;
+    }
+
+    wstring_view cell_view(const DataCell& cell) {
+        return wstring_view((const wchar_t*)cell.buffer.data(), cell.buffer.size() / sizeof(wchar_t));
+    }
+
+    // unordered_map<wstring_view, uint32_t> 每個值一個節點
+    const size_t lookup_node_bytes = sizeof(pair<const wstring_view, uint32_t>) + 2 * sizeof(void*);
+}
+
+uint32_t DictionaryColumn::find(wstring_view v) const {
+    auto it = lookup.find(v);
+    return it == lookup.end() ? null_code : it->second;
+}
+
+uint32_t DictionaryColumn::intern(wstring_view v) {
+    auto it = lookup.find(v);
+    if (it != lookup.end()) {
+        return it->second;
+    }
+    uint32_t code = (uint32_t)values.size();
+    values.emplace_back(v);
+    lookup.emplace(values.back(), code);
+    return code;
+}
+
+DataCell DictionaryColumn::cell(uint32_t code) const {
+    if (code == null_code) {
+        return DataCell({}, true, meta);
+    }
+    wstring_view v = values[code];
+    const BYTE* p = (const BYTE*)v.data();
+    return DataCell(vector<BYTE>(p, p + v.size() * sizeof(wchar_t)), false, meta);
+}
+
+MemoryUsage DictionaryColumn::memory_usage() const {
+    MemoryUsage usage;
+    usage.payload = heap_bytes(codes.capacity() * sizeof(uint32_t));
+    for (const wstring& v : values) {
+        usage.payload += heap_bytes(v);
+    }
+    usage.metadata = sizeof(ColumnMeta) + heap_bytes(meta.name);
+    // MSVC 的 deque 對 32 位元組的 wstring 每個區塊只放一個元素，另有一個 map 指標
+    usage.overhead = values.size() * (heap_bytes(sizeof(wstring)) + sizeof(void*))
+        + lookup.size() * heap_bytes(lookup_node_bytes)
+        + heap_bytes(2 * lookup.bucket_count() * sizeof(void*));
+    return usage;
+}
+
+EncodedTable::EncodedTable(EncodingOptions options) : options(move(options)) {}
+
+void EncodedTable::choose_columns(const DataRow& first) {
+    schema_ready = true;
+    for (const auto& kv : first) {
+        if (!is_wide_text(kv.second.meta.data_type)) {
+            continue;
+        }
+        if (!options.columns.empty() && std::find(options.columns.begin(), options.columns.end(), kv.first) == options.columns.end()) {
+            continue;
+        }
+        encoded.emplace(kv.first, DictionaryColumn(kv.second.meta));
+    }
+}
+
+size_t EncodedTable::append(DataRow&& row) {
+    if (!schema_ready) {
+        choose_columns(row);
+    }
+
+    size_t added = sizeof(uint32_t) * encoded.size();
+    for (auto it = encoded.begin(); it != encoded.end();) {
+        DictionaryColumn& column = it->second;
+        auto cell = row.find(it->first);
+
+        uint32_t code = DictionaryColumn::null_code;
+        if (cell != row.end() && !cell->second.is_null()) {
+            wstring_view v = cell_view(cell->second);
+            code = column.find(v);
+            if (code == DictionaryColumn::null_code) {
+                if (column.distinct() >= options.max_distinct) {
+                    // 基數太高：還原這一欄，這一列的 cell 留在 row 裡
+                    added += demote(column);
+                    it = encoded.erase(it);
+                    continue;
+                }
+                code = column.intern(v);
+                added += heap_bytes(sizeof(wstring)) + heap_bytes(column.value(code).size() * sizeof(wchar_t)) + heap_bytes(lookup_node_bytes);
+            }
+        }
+        column.codes.push_back(code);
+        if (cell != row.end()) {
+            row.erase(cell);
+        }
+        ++it;
+    }
+
+    added += SaoFU::memory_usage(row).total();
+    plain.emplace_back(move(row));
+    return added;
+}
+
+size_t EncodedTable::demote(DictionaryColumn& column) {
+    size_t added = 0;
+    for (size_t r = 0; r < plain.size(); ++r) {
+        size_t before = SaoFU::memory_usage(plain[r]).total();
+        plain[r].emplace(column.meta.name, column.cell(column.codes[r]));
+        added += SaoFU::memory_usage(plain[r]).total() - before;
+    }
+    return added;
+}
+
+bool EncodedTable::is_encoded(const wstring& column) const {
+    return encoded.count(column) > 0;
+}
+
+const DictionaryColumn* EncodedTable::dictionary(const wstring& column) const {
+    auto it = encoded.find(column);
+    return it == encoded.end() ? nullptr : &it->second;
+}
+
+vector<wstring> EncodedTable::encoded_columns() const {
+    vector<wstring> names;
+    for (const auto& kv : encoded) {
+        names.push_back(kv.first);
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+bool EncodedTable::is_null(size_t row, const wstring& column) const {
+    if (const DictionaryColumn* d = dictionary(column)) {
+        return d->codes.at(row) == DictionaryColumn::null_code;
+    }
+    auto it = plain.at(row).find(column);
+    return it == plain[row].end() || it->second.is_null();
+}
+
+wstring_view EncodedTable::text(size_t row, const wstring& column) const {
+    if (const DictionaryColumn* d = dictionary(column)) {
+        uint32_t code = d->codes.at(row);
+        return code == DictionaryColumn::null_code ? wstring_view() : d->value(code);
+    }
+
+    auto it = plain.at(row).find(column);
+    if (it == plain[row].end() || it->second.is_null()) {
+        return wstring_view();
+    }
+    if (!is_wide_text(it->second.meta.data_type)) {
+        throw logic_error("EncodedTable::text() on a non-Unicode column");
+    }
+    return cell_view(it->second);
+}
+
+DataRow EncodedTable::row(size_t index) const {
+    DataRow out = plain.at(index);
+    for (const auto& kv : encoded) {
+        out.emplace(kv.first, kv.second.cell(kv.second.codes[index]));
+    }
+    return out;
+}
+
+DataTable EncodedTable::decode() const {
+    DataTable table;
+    table.reserve(plain.size());
+    for (size_t r = 0; r < plain.size(); ++r) {
+        table.emplace_back(row(r));
+    }
+    return table;
+}
+
+vector<uint32_t> EncodedTable::filter_equal(const wstring& column, wstring_view value) const {
+    vector<uint32_t> selected;
+
+    if (const DictionaryColumn* d = dictionary(column)) {
+        uint32_t code = d->find(value);
+        if (code == DictionaryColumn::null_code) {
+            return selected;
+        }
+        for (size_t r = 0; r < d->codes.size(); ++r) {
+            if (d->codes[r] == code) selected.push_back((uint32_t)r);
+        }
+        return selected;
+    }
+
+    for (size_t r = 0; r < plain.size(); ++r) {
+        if (!is_null(r, column) && text(r, column) == value) selected.push_back((uint32_t)r);
+    }
+    return selected;
+}
+
+MemoryUsage EncodedTable::memory_usage() const {
+    MemoryUsage usage = SaoFU::memory_usage(plain);
+    for (const auto& kv : encoded) {
+        usage += kv.second.memory_usage();
+        usage.metadata += heap_bytes(kv.first);
+        usage.overhead += heap_bytes(sizeof(kv) + 2 * sizeof(void*));
+    }
+    usage.overhead += heap_bytes(2 * encoded.bucket_count() * sizeof(void*));
+    return usage;
+}
@@ -0,0 +1,98 @@
+﻿// EncodedTable.h
+#ifndef ENCODED_TABLE_H
+#define ENCODED_TABLE_H
+
+#include "DataTable.h"
+#include "MemoryAccounting.h"
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace SaoFU {
+    struct EncodingOptions {
+        // 不同值超過此數量時，該欄改回一般 cell（已取回的列會還原）
+        std::size_t max_distinct = 1024;
+        // 要編碼的欄位；空白表示所有 NCHAR / NVARCHAR 欄
+        std::vector<std::wstring> columns;
+    };
+
+    // 一欄的 dictionary 編碼：每列一個 code，相同字串只存一份
+    class DictionaryColumn {
+    public:
+        static constexpr std::uint32_t null_code = UINT32_MAX;
+
+        explicit DictionaryColumn(ColumnMeta meta) : meta(std::move(meta)) {}
+
+        DictionaryColumn(DictionaryColumn&&) = default;
+        DictionaryColumn& operator=(DictionaryColumn&&) = default;
+        DictionaryColumn(const DictionaryColumn&) = delete;
+        DictionaryColumn& operator=(const DictionaryColumn&) = delete;
+
+        ColumnMeta meta;
+        std::vector<std::uint32_t> codes;
+
+        std::size_t distinct() const { return values.size(); }
+        // 回傳的 view 與 DictionaryColumn 同壽命
+        std::wstring_view value(std::uint32_t code) const { return values[code]; }
+        // 不存在時回傳 null_code
+        std::uint32_t find(std::wstring_view v) const;
+        std::uint32_t intern(std::wstring_view v);
+        // 還原成 command() 會產生的 cell
+        DataCell cell(std::uint32_t code) const;
+
+        MemoryUsage memory_usage() const;
+    private:
+        std::deque<std::wstring> values; // deque 擴充時不搬移元素，lookup 的 key 與回傳的 view 一直有效
+        std::unordered_map<std::wstring_view, std::uint32_t> lookup;
+    };
+
+    // command_encoded() 的結果：低基數的寬字元文字欄在取回時就轉成 dictionary code，其餘欄位照舊存在 rows()
+    // 第一列決定候選欄位，之後某欄不同值超過 max_distinct 就還原成一般 cell
+    // 只編碼 SQL_WCHAR / SQL_WVARCHAR / SQL_WLONGVARCHAR，比較時以 code unit 比對（與 compare_cells() 相同）
+    class EncodedTable {
+    public:
+        explicit EncodedTable(EncodingOptions options = {});
+
+        EncodedTable(EncodedTable&&) = default;
+        EncodedTable& operator=(EncodedTable&&) = default;
+
+        // 回傳估計增加的位元組，供 MemoryReservation 計帳
+        std::size_t append(DataRow&& row);
+
+        std::size_t size() const { return plain.size(); }
+        bool is_encoded(const std::wstring& column) const;
+        // 未編碼的欄位回傳 nullptr
+        const DictionaryColumn* dictionary(const std::wstring& column) const;
+        std::vector<std::wstring> encoded_columns() const;
+        // 未編碼的欄位，列號與 size() 對齊
+        const DataTable& rows() const { return plain; }
+
+        bool is_null(std::size_t row, const std::wstring& column) const;
+        // 編碼欄回傳 dictionary 內的 view，一般寬字元欄回傳 cell buffer 的 view；NULL 為空字串
+        // 其他型別丟 std::logic_error
+        std::wstring_view text(std::size_t row, const std::wstring& column) const;
+
+        DataRow row(std::size_t index) const;
+        DataTable decode() const;
+
+        // column = value 的列號，遞增排列；編碼欄只比較 code
+        // 分組見 TableIndex.h 的 group_by(const EncodedTable&, ...)
+        std::vector<std::uint32_t> filter_equal(const std::wstring& column, std::wstring_view value) const;
+
+        MemoryUsage memory_usage() const;
+    private:
+        EncodingOptions options;
+        bool schema_ready = false;
+        std::unordered_map<std::wstring, DictionaryColumn> encoded;
+        DataTable plain;
+
+        void choose_columns(const DataRow& first);
+        std::size_t demote(DictionaryColumn& column);
+    };
+}
+
+#endif // ENCODED_TABLE_H
@@ -0,0 +1,126 @@
+﻿#include "EventAggregator.h"
+
+#include <functional>
+
+using namespace SaoFU;
+using namespace std;
+
+EventAggregator::EventAggregator(AggregatorOptions options) : opts(options) {
+    // FILETIME 以 100ns 為單位
+    window_ticks = (ULONGLONG)max<long long>(opts.window.count(), 0) * 10000000ull;
+}
+
+size_t EventAggregator::KeyHash::operator()(const KeyRef& k) const {
+    hash<wstring_view> h;
+    size_t seed = h(k.message);
+    seed ^= h(k.provider) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    seed ^= h(k.task) + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    seed ^= (size_t)k.event_id + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+    return seed;
+}
+
+EventAggregator::KeyRef EventAggregator::key_of(const AggregatedEvent& e) {
+    return KeyRef{ e.provider, e.event_id, e.task, e.message };
+}
+
+size_t EventAggregator::entry_bytes(const AggregatedEvent& e) {
+    // 字串本體加上 list 節點與 index 的大約負擔
+    return (e.provider.size() + e.task.size() + e.message.size()) * sizeof(wchar_t)
+        + sizeof(AggregatedEvent) + sizeof(KeyRef) + 6 * sizeof(void*);
+}
+
+ULONGLONG EventAggregator::system_time() {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+ULONGLONG EventAggregator::clock() const {
+    lock_guard<std::mutex> lock(mutex);
+    return opts.event_time_clock ? newest : max(newest, system_time());
+}
+
+// 結束一個視窗；只有真的壓下過事件才需要彙總列
+void EventAggregator::close(EntryList::iterator it) {
+    AggregatedEvent& e = *it;
+    index.erase(key_of(e));
+    counters.bytes -= entry_bytes(e);
+    if (e.count > 1) {
+        ready.emplace_back(move(e));
+        counters.summaries++;
+    }
+    entries.erase(it);
+}
+
+bool EventAggregator::observe(const wstring& provider, unsigned event_id, const wstring& task,
+                              const wstring& message, ULONGLONG event_time) {
+    lock_guard<std::mutex> lock(mutex);
+    counters.observed++;
+    // 即時訂閱時，時間錯誤、跑到未來的事件以當下的系統時間計：
+    // 不然它會把時鐘永久往前推，之後每個視窗都在下一次 expire() 就結束，也會擋住排在它後面的視窗
+    const ULONGLONG timestamp = opts.event_time_clock ? event_time : min(event_time, system_time());
+    newest = max(newest, timestamp);
+
+    auto it = index.find(KeyRef{ provider, event_id, task, message });
+    if (it != index.end()) {
+        AggregatedEvent& e = *it->second;
+        if (timestamp < e.first_seen + window_ticks) {
+            e.count++;
+            e.last_seen = max(e.last_seen, timestamp);
+            counters.suppressed++;
+            return false;
+        }
+        // 視窗已過但還沒被 expire() 取走：先結束它，這次當成新視窗的第一次
+        close(it->second);
+    }
+
+    AggregatedEvent e;
+    e.provider = provider;
+    e.event_id = event_id;
+    e.task = task;
+    e.message = message;
+    e.first_seen = timestamp;
+    e.last_seen = timestamp;
+    e.count = 1;
+
+    const size_t bytes = entry_bytes(e);
+    while (!entries.empty() && (entries.size() >= opts.max_entries || counters.bytes + bytes > opts.max_bytes)) {
+        close(entries.begin());
+        counters.evicted++;
+    }
+
+    if (bytes <= opts.max_bytes && opts.max_entries > 0) {
+        entries.emplace_back(move(e));
+        index.emplace(key_of(entries.back()), prev(entries.end()));
+        counters.bytes += bytes;
+    }
+    counters.passed++;
+    return true;
+}
+
+vector<AggregatedEvent> EventAggregator::expire(ULONGLONG now) {
+    lock_guard<std::mutex> lock(mutex);
+    while (!entries.empty() && entries.front().first_seen + window_ticks <= now) {
+        close(entries.begin());
+    }
+    vector<AggregatedEvent> out;
+    out.swap(ready);
+    return out;
+}
+
+vector<AggregatedEvent> EventAggregator::flush_all() {
+    lock_guard<std::mutex> lock(mutex);
+    while (!entries.empty()) {
+        close(entries.begin());
+    }
+    vector<AggregatedEvent> out;
+    out.swap(ready);
+    return out;
+}
+
+AggregatorStats EventAggregator::stats() const {
+    lock_guard<std::mutex> lock(mutex);
+    AggregatorStats s = counters;
+    s.entries = entries.size();
+    return s;
+}
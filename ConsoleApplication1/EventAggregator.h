@@ -0,0 +1,106 @@
+﻿// EventAggregator.h
+#ifndef EVENT_AGGREGATOR_H
+#define EVENT_AGGREGATOR_H
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace SaoFU {
+    struct AggregatorOptions {
+        std::chrono::seconds window{ 60 };     // 同一個 key 從第一次出現起算的彙總時間
+        std::size_t max_entries = 4096;        // 同時追蹤的 key 上限
+        std::size_t max_bytes = 16 << 20;      // 追蹤中字串的估計總量上限
+        // false（即時訂閱）：時鐘取 max(最新事件時間, 系統時間)，事件時間超過系統時間的部分不採用
+        // true（重播）：時鐘只跟著事件時間走，不限速重播時一秒內就能走過好幾個視窗
+        bool event_time_clock = false;
+    };
+
+    // 一個視窗內同一事件的彙總；count 含已立即寫入的第一次
+    struct AggregatedEvent {
+        std::wstring provider;
+        unsigned event_id = 0;
+        std::wstring task;
+        std::wstring message;
+        ULONGLONG first_seen = 0;  // FILETIME ticks（UTC）
+        ULONGLONG last_seen = 0;
+        std::uint64_t count = 0;
+    };
+
+    struct AggregatorStats {
+        std::uint64_t observed = 0;
+        std::uint64_t passed = 0;        // 視窗內第一次出現，交給呼叫端立即寫入
+        std::uint64_t suppressed = 0;    // 併入彙總、不個別寫入
+        std::uint64_t summaries = 0;     // 產生的彙總列
+        std::uint64_t evicted = 0;       // 因容量上限提早結束的視窗
+        std::size_t entries = 0;
+        std::size_t bytes = 0;
+    };
+
+    // 以 (provider, event id, task, message) 為 key 做視窗去重；視窗是每個 key 各自的 tumbling window，
+    // 從該 key 第一次出現起算固定長度，不會隨後續事件延長
+    // 第一次出現時 observe() 回傳 true，之後同 key 只累計；視窗結束時若有被壓下的事件就產生一筆 AggregatedEvent
+    // 視窗依建立順序排列，超過上限時提早結束最舊的視窗（彙總照常產生，不會遺失計數）
+    // 所有公開方法都可從多條執行緒呼叫
+    class EventAggregator {
+    public:
+        explicit EventAggregator(AggregatorOptions options = {});
+
+        bool observe(const std::wstring& provider, unsigned event_id, const std::wstring& task,
+                     const std::wstring& message, ULONGLONG timestamp);
+
+        // 取走 now 之前已結束的視窗（含被提早結束的）；now 通常是 clock()
+        std::vector<AggregatedEvent> expire(ULONGLONG now);
+        // 結束所有視窗，關閉前呼叫
+        std::vector<AggregatedEvent> flush_all();
+
+        AggregatorStats stats() const;
+        const AggregatorOptions& options() const { return opts; }
+
+        // 目前的視窗時鐘，見 AggregatorOptions::event_time_clock
+        ULONGLONG clock() const;
+        static ULONGLONG system_time();
+    private:
+        struct KeyRef {
+            std::wstring_view provider;
+            unsigned event_id;
+            std::wstring_view task;
+            std::wstring_view message;
+
+            bool operator==(const KeyRef& other) const {
+                return event_id == other.event_id && provider == other.provider
+                    && task == other.task && message == other.message;
+            }
+        };
+        struct KeyHash {
+            std::size_t operator()(const KeyRef& k) const;
+        };
+
+        using EntryList = std::list<AggregatedEvent>;
+
+        AggregatorOptions opts;
+        ULONGLONG window_ticks;
+
+        mutable std::mutex mutex;
+        EntryList entries;  // 依 first_seen 建立順序，也就是結束順序
+        // key 內的 view 指向 entries 中的字串，list 節點不會搬移
+        std::unordered_map<KeyRef, EntryList::iterator, KeyHash> index;
+        std::vector<AggregatedEvent> ready;
+        ULONGLONG newest = 0;  // observe() 看過最新的事件時間；即時訂閱時不超過當下的系統時間
+        AggregatorStats counters;
+
+        static KeyRef key_of(const AggregatedEvent& e);
+        static std::size_t entry_bytes(const AggregatedEvent& e);
+        void close(EntryList::iterator it);
+    };
+}
+
+#endif // EVENT_AGGREGATOR_H
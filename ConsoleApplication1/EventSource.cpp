@@ -0,0 +1,656 @@
+﻿#include "EventSource.h"
+
+#include "Utf8.h"
+
+#include <winevt.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#pragma comment(lib, "wevtapi.lib")
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    ULONGLONG filetime_now() {
+        FILETIME ft;
+        GetSystemTimeAsFileTime(&ft);
+        return ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    }
+
+    // 比排程早超過 1ms 才睡，避免高速率時每筆都進核心
+    void pace(chrono::steady_clock::time_point due) {
+        if (due - chrono::steady_clock::now() > chrono::milliseconds(1)) {
+            this_thread::sleep_until(due);
+        }
+    }
+}
+
+// ---------- Windows 事件記錄 ----------
+
+static wstring FormatEventMessage(EVT_HANDLE hMetadata, EVT_HANDLE hEvent, DWORD flags) {
+    DWORD dwBufferUsed = 0;
+    vector<WCHAR> messageBuffer;
+
+    if (!EvtFormatMessage(hMetadata, hEvent, 0, 0, NULL, flags, 0, NULL, &dwBufferUsed)) {
+        if (GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
+            messageBuffer.resize(dwBufferUsed);
+            if (EvtFormatMessage(hMetadata, hEvent, 0, 0, NULL, flags, dwBufferUsed, messageBuffer.data(), &dwBufferUsed)) {
+                return wstring(messageBuffer.data());
+            }
+            else {
+                return L"Failed to format message. Error: " + to_wstring(GetLastError());
+            }
+        }
+        else {
+            LPVOID lpMsgBuf;
+            DWORD bufLen = FormatMessageW(
+                FORMAT_MESSAGE_ALLOCATE_BUFFER |
+                FORMAT_MESSAGE_FROM_SYSTEM |
+                FORMAT_MESSAGE_IGNORE_INSERTS,
+                NULL,
+                GetLastError(),
+                MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+                (LPWSTR)&lpMsgBuf,
+                0, 
+                NULL
+            );
+            return L"Failed to get required buffer size. Error: " + wstring((LPWSTR)lpMsgBuf) + L" " + to_wstring(GetLastError());
+        }
+    }
+    return L"";
+}
+
+// 事件订阅回调函数：渲染成 EventRecord 後交給 WindowsEventSource 的 sink
+static DWORD WINAPI EvtSubscribeCallback(EVT_SUBSCRIBE_NOTIFY_ACTION action, WindowsEventSource* source, EVT_HANDLE hEvent) {
+    if (action == EvtSubscribeActionDeliver) {
+        DWORD status = ERROR_SUCCESS;
+        EVT_HANDLE hContext = EvtCreateRenderContext(0, NULL, EvtRenderContextSystem);
+        if (!hContext) {
+            return GetLastError();
+        }
+
+        DWORD dwBufferUsed = 0;
+        DWORD dwPropertyCount = 0;
+
+        // 取得所需的 Buffer 大小
+        if (!EvtRender(hContext, hEvent, EvtRenderEventValues, 0, NULL, &dwBufferUsed, &dwPropertyCount)) {
+            if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+                EvtClose(hContext);
+                return GetLastError();
+            }
+        }
+
+        // 使用 std::vector 來管理 Buffer
+        vector<BYTE> buffer(dwBufferUsed);
+        PEVT_VARIANT pRenderedValues = (PEVT_VARIANT)buffer.data();
+
+        if (!EvtRender(hContext, hEvent, EvtRenderEventValues, dwBufferUsed, pRenderedValues, &dwBufferUsed,
+            &dwPropertyCount)) {
+            EvtClose(hContext);
+            return GetLastError();
+        }
+
+        // 從事件取得 Publisher 名稱，以開啟 Metadata
+        EVT_HANDLE hMetadata = NULL;
+        EventRecord e;
+        e.created = chrono::steady_clock::now();
+
+        if (pRenderedValues[EvtSystemProviderName].Type == EvtVarTypeString) {
+            e.provider = pRenderedValues[EvtSystemProviderName].StringVal;
+            hMetadata = EvtOpenPublisherMetadata(NULL, pRenderedValues[EvtSystemProviderName].StringVal, NULL, 0, 0);
+        }
+
+        e.event_id = pRenderedValues[EvtSystemEventID].UInt16Val;
+        e.timestamp = pRenderedValues[EvtSystemTimeCreated].FileTimeVal;
+        if (pRenderedValues[EvtSystemLevel].Type == EvtVarTypeByte) {
+            e.level = pRenderedValues[EvtSystemLevel].ByteVal;
+        }
+        e.message = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageEvent);
+        e.keyword = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageKeyword);
+        e.task = FormatEventMessage(hMetadata, hEvent, EvtFormatMessageTask);
+
+        if (hMetadata)
+            EvtClose(hMetadata);
+
+        EvtClose(hContext);
+
+        source->deliver(move(e));
+        return status;
+    }
+    return 0;
+}
+
+WindowsEventSource::WindowsEventSource(wstring query) : query(move(query)) {}
+
+void WindowsEventSource::run(const EventSink& s) {
+    sink = &s;
+    EVT_HANDLE hSubscription = EvtSubscribe(
+        NULL,
+        NULL,
+        NULL,
+        query.c_str(),
+        NULL,
+        this,
+        (EVT_SUBSCRIBE_CALLBACK)EvtSubscribeCallback,
+        EvtSubscribeToFutureEvents
+    );
+    if (!hSubscription) {
+        sink = nullptr;
+        throw runtime_error("Failed to subscribe to events. Error: " + to_string(GetLastError()));
+    }
+
+    {
+        unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return stopping; });
+    }
+
+    // EvtClose 返回後不會再有回呼
+    EvtClose(hSubscription);
+    sink = nullptr;
+}
+
+void WindowsEventSource::stop() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+}
+
+// ---------- 合成事件 ----------
+
+namespace {
+    // Zipf 分布的累積權重，抽樣時二分搜尋
+    vector<double> zipf_cdf(size_t n, double s) {
+        vector<double> cdf(n);
+        double sum = 0;
+        for (size_t k = 0; k < n; ++k) {
+            sum += 1.0 / pow((double)(k + 1), s);
+            cdf[k] = sum;
+        }
+        return cdf;
+    }
+
+    size_t sample(const vector<double>& cdf, mt19937_64& rng) {
+        uniform_real_distribution<double> u(0.0, cdf.back());
+        size_t k = lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin();
+        return min(k, cdf.size() - 1);
+    }
+}
+
+SyntheticEventSource::SyntheticEventSource(SyntheticOptions options) : opts(options) {}
+
+void SyntheticEventSource::run(const EventSink& sink) {
+    static const wchar_t* words[] = {
+        L"An", L"account", L"was", L"successfully", L"logged", L"on", L"failed", L"to", L"service",
+        L"process", L"connection", L"timeout", L"policy", L"changed", L"user", L"network", L"driver",
+    };
+    static const wchar_t* keywords[] = { L"Audit Success", L"Audit Failure", L"Classic", L"Error" };
+    const size_t word_count = sizeof(words) / sizeof(words[0]);
+
+    mt19937_64 rng(opts.seed);
+    const vector<double> provider_cdf = zipf_cdf(max<size_t>(opts.provider_count, 1), opts.zipf_s);
+    const vector<double> id_cdf = zipf_cdf(max<size_t>(opts.event_id_count, 1), opts.zipf_s);
+    lognormal_distribution<double> length(log(max(opts.message_mean, 1.0)), max(opts.message_sigma, 0.0));
+    bernoulli_distribution unique(min(max(opts.unique_ratio, 0.0), 1.0));
+
+    discrete_distribution<int> level(begin(opts.level_weights), end(opts.level_weights));
+
+    // 每組 (provider, event id) 的訊息範本與等級在第一次用到時產生
+    struct Template {
+        wstring message;
+        BYTE level = 4;
+    };
+    unordered_map<uint64_t, Template> templates;
+
+    using clock = chrono::steady_clock;
+    const auto start = clock::now();
+    for (size_t i = 0; i < opts.count && !stopping.load(memory_order_relaxed); ++i) {
+        if (opts.rate > 0) {
+            pace(start + chrono::duration_cast<clock::duration>(chrono::duration<double>(i / opts.rate)));
+        }
+
+        size_t p = sample(provider_cdf, rng);
+        size_t id = sample(id_cdf, rng);
+
+        Template& t = templates[((uint64_t)p << 32) | id];
+        if (t.message.empty()) {
+            size_t n = min<size_t>(max<size_t>((size_t)length(rng), 1), 32000);
+            while (t.message.size() < n) {
+                t.message += words[rng() % word_count];
+                t.message += L' ';
+            }
+            t.message.resize(n);
+            t.level = (BYTE)(1 + level(rng));
+        }
+
+        EventRecord e;
+        e.created = clock::now();
+        e.provider = L"SaoFU-Synthetic-" + to_wstring(p);
+        e.event_id = (unsigned)(1000 + id);
+        e.keyword = keywords[id % 4];
+        e.task = L"Task " + to_wstring(id % 16);
+        e.level = t.level;
+        e.message = t.message;
+        if (unique(rng)) {
+            e.message += L" #" + to_wstring(i);
+        }
+        e.timestamp = filetime_now();
+        sink(move(e));
+    }
+}
+
+void SyntheticEventSource::stop() {
+    stopping = true;
+}
+
+// ---------- 事件檔 ----------
+
+namespace {
+    void append_utf8(string& out, uint32_t cp) {
+        wstring w;
+        if (cp >= 0x10000 && sizeof(wchar_t) == 2) {
+            cp -= 0x10000;
+            w.push_back((wchar_t)(0xD800 + (cp >> 10)));
+            w.push_back((wchar_t)(0xDC00 + (cp & 0x3FF)));
+        }
+        else {
+            w.push_back((wchar_t)cp);
+        }
+        wide_to_utf8(w, out);
+    }
+
+    // 整個字串都是數字且不溢位時才成功；不丟例外，壞掉的紀錄交給呼叫端計入 skipped
+    template<typename T>
+    bool parse_number(const string& s, T& out, int base = 10) {
+        if (s.empty()) return false;
+        auto [end, ec] = from_chars(s.data(), s.data() + s.size(), out, base);
+        return ec == errc() && end == s.data() + s.size();
+    }
+
+    bool parse_hex4(const string& s, size_t i, uint32_t& v) {
+        if (i + 4 > s.size()) return false;
+        v = 0;
+        for (size_t k = i; k < i + 4; ++k) {
+            char c = s[k];
+            v <<= 4;
+            if (c >= '0' && c <= '9') v |= c - '0';
+            else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+            else return false;
+        }
+        return true;
+    }
+
+    void skip_space(const string& s, size_t& i) {
+        while (i < s.size() && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r' || s[i] == '\n')) ++i;
+    }
+
+    bool parse_json_string(const string& s, size_t& i, string& out) {
+        if (i >= s.size() || s[i] != '"') return false;
+        ++i;
+        out.clear();
+        while (i < s.size()) {
+            char c = s[i++];
+            if (c == '"') return true;
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (i >= s.size()) return false;
+            char esc = s[i++];
+            switch (esc) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t cp;
+                if (!parse_hex4(s, i, cp)) return false;
+                i += 4;
+                if (cp >= 0xD800 && cp <= 0xDBFF && i + 6 <= s.size() && s[i] == '\\' && s[i + 1] == 'u') {
+                    uint32_t low;
+                    if (parse_hex4(s, i + 2, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    // 只處理一層物件，值為字串、數字或 true / false / null；巢狀結構視為錯誤
+    bool parse_json_object(const string& s, unordered_map<string, string>& out) {
+        size_t i = 0;
+        skip_space(s, i);
+        if (i >= s.size() || s[i] != '{') return false;
+        ++i;
+        skip_space(s, i);
+        if (i < s.size() && s[i] == '}') return true;
+
+        string key;
+        string value;
+        while (i < s.size()) {
+            skip_space(s, i);
+            if (!parse_json_string(s, i, key)) return false;
+            skip_space(s, i);
+            if (i >= s.size() || s[i] != ':') return false;
+            ++i;
+            skip_space(s, i);
+            if (i < s.size() && s[i] == '"') {
+                if (!parse_json_string(s, i, value)) return false;
+            }
+            else {
+                size_t start = i;
+                while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ' ' && s[i] != '\t') ++i;
+                value = s.substr(start, i - start);
+                if (value.empty() || value[0] == '{' || value[0] == '[') return false;
+            }
+            out[key] = value;
+            skip_space(s, i);
+            if (i < s.size() && s[i] == ',') { ++i; continue; }
+            if (i < s.size() && s[i] == '}') return true;
+            return false;
+        }
+        return false;
+    }
+
+    bool parse_event_time(const string& value, ULONGLONG& ticks) {
+        if (!value.empty() && value.find_first_not_of("0123456789") == string::npos) {
+            unsigned long long v;
+            if (!parse_number(value, v)) return false;
+            ticks = v;
+            return true;
+        }
+        return parse_iso8601(value, ticks);
+    }
+
+    bool parse_json_event(const string& line, EventRecord& e) {
+        unordered_map<string, string> fields;
+        if (!parse_json_object(line, fields)) return false;
+
+        auto id = fields.find("event_id");
+        auto time = fields.find("time");
+        if (id == fields.end() || time == fields.end()) return false;
+        if (id->second.find_first_not_of("0123456789") != string::npos || !parse_number(id->second, e.event_id)) return false;
+        if (!parse_event_time(time->second, e.timestamp)) return false;
+
+        e.provider = utf8_to_wide(fields["provider"]);
+        e.keyword = utf8_to_wide(fields["keyword"]);
+        e.task = utf8_to_wide(fields["task"]);
+        e.message = utf8_to_wide(fields["message"]);
+
+        // 沒有 level 時維持 Information
+        auto level = fields.find("level");
+        if (level == fields.end()) level = fields.find("Level");
+        unsigned value;
+        if (level != fields.end() && level->second.find_first_not_of("0123456789") == string::npos
+            && parse_number(level->second, value)) {
+            e.level = (BYTE)min(value, 255u);
+        }
+        return true;
+    }
+
+    string xml_decode(const string& s) {
+        string out;
+        out.reserve(s.size());
+        for (size_t i = 0; i < s.size(); ++i) {
+            if (s[i] != '&') {
+                out.push_back(s[i]);
+                continue;
+            }
+            size_t end = s.find(';', i);
+            if (end == string::npos) {
+                out.push_back(s[i]);
+                continue;
+            }
+            string entity = s.substr(i + 1, end - i - 1);
+            if (entity == "lt") out.push_back('<');
+            else if (entity == "gt") out.push_back('>');
+            else if (entity == "amp") out.push_back('&');
+            else if (entity == "quot") out.push_back('"');
+            else if (entity == "apos") out.push_back('\'');
+            else if (entity.size() > 1 && entity[0] == '#') {
+                // 數字不合法或超出 Unicode 範圍時原樣保留
+                bool hex = entity[1] == 'x' || entity[1] == 'X';
+                string digits = entity.substr(hex ? 2 : 1);
+                uint32_t cp;
+                if (parse_number(digits, cp, hex ? 16 : 10) && cp <= 0x10FFFF) {
+                    append_utf8(out, cp);
+                }
+                else {
+                    out.append(s, i, end - i + 1);
+                }
+            }
+            else {
+                out.append(s, i, end - i + 1);
+            }
+            i = end;
+        }
+        return out;
+    }
+
+    // 找 <tag 開頭的元素，名稱後面必須是空白、> 或 /，避免 <Event 比對到 <EventID
+    size_t find_element(const string& s, const string& tag, size_t from, size_t to) {
+        string open = "<" + tag;
+        for (size_t pos = s.find(open, from); pos != string::npos && pos < to; pos = s.find(open, pos + 1)) {
+            size_t after = pos + open.size();
+            if (after < s.size() && (s[after] == ' ' || s[after] == '>' || s[after] == '/' || s[after] == '\t'
+                || s[after] == '\r' || s[after] == '\n')) {
+                return pos;
+            }
+        }
+        return string::npos;
+    }
+
+    bool xml_text(const string& s, const string& tag, size_t from, size_t to, string& out) {
+        size_t pos = find_element(s, tag, from, to);
+        if (pos == string::npos) return false;
+        size_t gt = s.find('>', pos);
+        if (gt == string::npos || gt >= to || s[gt - 1] == '/') return false;
+        size_t close = s.find("</" + tag + ">", gt);
+        if (close == string::npos || close > to) return false;
+        out = xml_decode(s.substr(gt + 1, close - gt - 1));
+        return true;
+    }
+
+    bool xml_attr(const string& s, const string& tag, const string& attr, size_t from, size_t to, string& out) {
+        size_t pos = find_element(s, tag, from, to);
+        if (pos == string::npos) return false;
+        size_t gt = s.find('>', pos);
+        if (gt == string::npos) return false;
+        size_t a = s.find(attr + "=", pos);
+        if (a == string::npos || a > gt) return false;
+        size_t q = a + attr.size() + 1;
+        if (q >= s.size() || (s[q] != '\'' && s[q] != '"')) return false;
+        size_t end = s.find(s[q], q + 1);
+        if (end == string::npos || end > gt) return false;
+        out = xml_decode(s.substr(q + 1, end - q - 1));
+        return true;
+    }
+
+    bool parse_xml_event(const string& s, size_t from, size_t to, EventRecord& e) {
+        string provider, id, time;
+        if (!xml_attr(s, "Provider", "Name", from, to, provider)) return false;
+        if (!xml_text(s, "EventID", from, to, id) || id.find_first_not_of("0123456789") != string::npos
+            || !parse_number(id, e.event_id)) return false;
+        if (!xml_attr(s, "TimeCreated", "SystemTime", from, to, time) || !parse_iso8601(time, e.timestamp)) return false;
+
+        e.provider = utf8_to_wide(provider);
+
+        // 文字訊息在 RenderingInfo 裡；System 底下的 <Task> 只是數字
+        size_t rendering = find_element(s, "RenderingInfo", from, to);
+
+        // 數字等級在 System 底下，RenderingInfo 裡的 <Level> 是顯示名稱
+        string level;
+        unsigned value;
+        if (xml_text(s, "Level", from, rendering == string::npos ? to : rendering, level)
+            && level.find_first_not_of("0123456789") == string::npos && parse_number(level, value)) {
+            e.level = (BYTE)min(value, 255u);
+        }
+        if (rendering != string::npos) {
+            string text;
+            if (xml_text(s, "Message", rendering, to, text)) e.message = utf8_to_wide(text);
+            if (xml_text(s, "Task", rendering, to, text)) e.task = utf8_to_wide(text);
+            if (xml_text(s, "Keyword", rendering, to, text)) e.keyword = utf8_to_wide(text);
+        }
+        return true;
+    }
+}
+
+bool SaoFU::parse_iso8601(const string& text, ULONGLONG& ticks) {
+    int y, mo, d, h, mi, sec;
+    if (text.size() < 19 || text[4] != '-' || text[7] != '-' || (text[10] != 'T' && text[10] != ' ')
+        || text[13] != ':' || text[16] != ':') {
+        return false;
+    }
+    auto digits = [&](size_t pos, size_t n, int& v) {
+        v = 0;
+        for (size_t k = pos; k < pos + n; ++k) {
+            if (text[k] < '0' || text[k] > '9') return false;
+            v = v * 10 + (text[k] - '0');
+        }
+        return true;
+    };
+    if (!digits(0, 4, y) || !digits(5, 2, mo) || !digits(8, 2, d) || !digits(11, 2, h) || !digits(14, 2, mi)
+        || !digits(17, 2, sec) || y < 1601 || mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || sec > 60) {
+        return false;
+    }
+
+    // 小數秒最多取 7 位（100ns）
+    size_t i = 19;
+    ULONGLONG fraction = 0;
+    if (i < text.size() && text[i] == '.') {
+        int n = 0;
+        for (++i; i < text.size() && text[i] >= '0' && text[i] <= '9'; ++i) {
+            if (n < 7) {
+                fraction = fraction * 10 + (text[i] - '0');
+                ++n;
+            }
+        }
+        for (; n < 7; ++n) fraction *= 10;
+    }
+
+    long long offset_minutes = 0;
+    if (i < text.size() && (text[i] == '+' || text[i] == '-')) {
+        int oh, om;
+        if (i + 6 > text.size() || text[i + 3] != ':' || !digits(i + 1, 2, oh) || !digits(i + 4, 2, om)) return false;
+        offset_minutes = (text[i] == '-' ? -1 : 1) * (oh * 60 + om);
+    }
+    else if (i < text.size() && text[i] != 'Z') {
+        return false;
+    }
+
+    // days_from_civil，以 1601-01-01 為第 0 天
+    auto days_from_civil = [](long long yy, unsigned m, unsigned dd) {
+        yy -= m <= 2;
+        long long era = (yy >= 0 ? yy : yy - 399) / 400;
+        unsigned yoe = (unsigned)(yy - era * 400);
+        unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + dd - 1;
+        unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + (long long)doe;
+    };
+    long long days = days_from_civil(y, mo, d) - days_from_civil(1601, 1, 1);
+    long long seconds = days * 86400 + h * 3600 + mi * 60 + sec - offset_minutes * 60;
+    if (seconds < 0) return false;
+
+    ticks = (ULONGLONG)seconds * 10000000ull + fraction;
+    return true;
+}
+
+vector<EventRecord> SaoFU::parse_event_text(const string& text, size_t* skipped) {
+    vector<EventRecord> events;
+    size_t bad = 0;
+
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first != string::npos && text[first] == '<') {
+        for (size_t pos = find_element(text, "Event", 0, text.size()); pos != string::npos;) {
+            size_t end = text.find("</Event>", pos);
+            if (end == string::npos) {
+                ++bad;
+                break;
+            }
+            EventRecord e;
+            if (parse_xml_event(text, pos, end, e)) events.emplace_back(move(e));
+            else ++bad;
+            pos = find_element(text, "Event", end, text.size());
+        }
+    }
+    else {
+        istringstream in(text);
+        string line;
+        while (getline(in, line)) {
+            if (line.find_first_not_of(" \t\r") == string::npos) continue;
+            EventRecord e;
+            if (parse_json_event(line, e)) events.emplace_back(move(e));
+            else ++bad;
+        }
+    }
+
+    if (skipped) *skipped = bad;
+    return events;
+}
+
+vector<EventRecord> SaoFU::load_event_file(const wstring& path, size_t* skipped) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        throw runtime_error("Failed to open event file");
+    }
+    string raw((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+
+    // PowerShell 轉向輸出常是 UTF-16LE
+    if (raw.size() >= 2 && (unsigned char)raw[0] == 0xFF && (unsigned char)raw[1] == 0xFE) {
+        return parse_event_text(wide_to_utf8(wstring_view((const wchar_t*)(raw.data() + 2), (raw.size() - 2) / sizeof(wchar_t))), skipped);
+    }
+    if (raw.size() >= 3 && (unsigned char)raw[0] == 0xEF && (unsigned char)raw[1] == 0xBB && (unsigned char)raw[2] == 0xBF) {
+        raw.erase(0, 3);
+    }
+    return parse_event_text(raw, skipped);
+}
+
+ReplayEventSource::ReplayEventSource(ReplayOptions options) : opts(move(options)) {}
+
+void ReplayEventSource::run(const EventSink& sink) {
+    vector<EventRecord> events = load_event_file(opts.path, &skipped_records);
+    if (events.empty()) return;
+
+    using clock = chrono::steady_clock;
+    const ULONGLONG base = events.front().timestamp;
+    const ULONGLONG now = filetime_now();
+    const auto start = clock::now();
+
+    for (EventRecord& e : events) {
+        if (stopping.load(memory_order_relaxed)) break;
+
+        ULONGLONG offset = e.timestamp >= base ? e.timestamp - base : 0;
+        if (opts.speed > 0) {
+            pace(start + chrono::duration_cast<clock::duration>(chrono::duration<double>(offset / 1e7 / opts.speed)));
+        }
+        e.timestamp = now + offset;
+        e.created = clock::now();
+        sink(move(e));
+    }
+}
+
+void ReplayEventSource::stop() {
+    stopping = true;
+}
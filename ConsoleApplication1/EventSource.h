@@ -0,0 +1,115 @@
+﻿// EventSource.h
+#ifndef EVENT_SOURCE_H
+#define EVENT_SOURCE_H
+
+#define NOMINMAX
+#include <windows.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SaoFU {
+    // 渲染後的事件，與來源無關；寫入 event.dbo.even 所需的欄位都在這裡
+    struct EventRecord {
+        std::wstring provider;
+        unsigned event_id = 0;
+        std::wstring keyword;
+        std::wstring task;
+        std::wstring message;
+        ULONGLONG timestamp = 0;  // FILETIME ticks（UTC）
+        // 事件等級：1 Critical、2 Error、3 Warning、4 Information、5 Verbose，0 為 LogAlways
+        BYTE level = 4;
+        // 來源產生這筆事件的時間，負載測試用來算端到端延遲
+        std::chrono::steady_clock::time_point created{};
+    };
+
+    using EventSink = std::function<void(EventRecord&&)>;
+
+    class EventSource {
+    public:
+        virtual ~EventSource() = default;
+        // 把事件依序交給 sink，直到來源用完或 stop()；會阻塞呼叫端
+        virtual void run(const EventSink& sink) = 0;
+        // 可從其他執行緒呼叫
+        virtual void stop() = 0;
+    };
+
+    // EvtSubscribe 訂閱；sink 在系統的回呼執行緒上被呼叫
+    class WindowsEventSource : public EventSource {
+    public:
+        explicit WindowsEventSource(std::wstring query);
+        void run(const EventSink& sink) override;
+        void stop() override;
+
+        // 給 EvtSubscribe 回呼使用
+        void deliver(EventRecord&& e) { (*sink)(std::move(e)); }
+    private:
+        std::wstring query;
+        const EventSink* sink = nullptr;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stopping = false;
+    };
+
+    struct SyntheticOptions {
+        double rate = 1000;                 // events/sec，0 表示不限速
+        std::size_t count = 100000;         // 總數
+        std::size_t provider_count = 20;
+        std::size_t event_id_count = 200;
+        double zipf_s = 1.1;                // provider 與 event id 的 Zipf 偏斜，越大越集中
+        double message_mean = 200;          // 訊息長度（字元）的 log-normal 中位數
+        double message_sigma = 0.6;
+        double unique_ratio = 0.1;          // 訊息附加流水號、不會被彙總合併的比例
+        // Critical、Error、Warning、Information、Verbose 的比重，每組 provider / event id 固定一個等級
+        double level_weights[5] = { 1, 4, 10, 70, 15 };
+        std::uint64_t seed = 42;
+    };
+
+    // 依 SyntheticOptions 的分布產生事件；同一組 provider / event id 的訊息固定，模擬事件範本
+    class SyntheticEventSource : public EventSource {
+    public:
+        explicit SyntheticEventSource(SyntheticOptions options);
+        void run(const EventSink& sink) override;
+        void stop() override;
+    private:
+        SyntheticOptions opts;
+        std::atomic<bool> stopping{ false };
+    };
+
+    // 讀取 UTF-8（或 UTF-16 BOM）的事件檔：
+    //   JSONL：每行一個物件，欄位 provider、event_id、level、keyword、task、message、time
+    //          time 可為 ISO-8601 字串或 FILETIME ticks
+    //   XML：wevtutil qe /f:RenderedXml 的輸出，一個 <Event> 一筆
+    // 無法解析的紀錄略過並計入 skipped
+    std::vector<EventRecord> load_event_file(const std::wstring& path, std::size_t* skipped = nullptr);
+    std::vector<EventRecord> parse_event_text(const std::string& utf8, std::size_t* skipped = nullptr);
+
+    // 把 "2024-05-01T12:00:00.1234567Z" 轉成 FILETIME ticks；不合法時回傳 false
+    bool parse_iso8601(const std::string& text, ULONGLONG& ticks);
+
+    struct ReplayOptions {
+        std::wstring path;
+        double speed = 0;  // 0 表示不限速，1 表示依原始時間間隔，2 表示兩倍速
+    };
+
+    // 重播 load_event_file() 的結果；時間戳平移到重播開始的時刻，保留原本的間隔
+    class ReplayEventSource : public EventSource {
+    public:
+        explicit ReplayEventSource(ReplayOptions options);
+        void run(const EventSink& sink) override;
+        void stop() override;
+        std::size_t skipped() const { return skipped_records; }
+    private:
+        ReplayOptions opts;
+        std::atomic<bool> stopping{ false };
+        std::size_t skipped_records = 0;
+    };
+}
+
+#endif // EVENT_SOURCE_H
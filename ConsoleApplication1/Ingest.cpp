@@ -0,0 +1,322 @@
+﻿#include "Ingest.h"
+
+#include <iostream>
+
+using namespace SaoFU;
+using namespace std;
+
+static wstring formatFileTimeToSQLDateTime(const FILETIME* ft) {
+    FILETIME localFt;
+    SYSTEMTIME st;
+
+    // 轉成本地時間
+    FileTimeToLocalFileTime(ft, &localFt);
+    FileTimeToSystemTime(&localFt, &st);
+
+    wchar_t date_buf[64];
+    wchar_t time_buf[64];
+
+    if (GetDateFormatEx(LOCALE_NAME_USER_DEFAULT, 0, &st, nullptr, date_buf, 64, nullptr) &&
+        GetTimeFormatEx(LOCALE_NAME_USER_DEFAULT, 0, &st, nullptr, time_buf, 64)) {
+
+        wchar_t result_buf[128];
+        swprintf(result_buf, 128, L"%s %s.%03d", date_buf, time_buf, st.wMilliseconds);
+        return result_buf;
+    }
+
+    return L"";
+}
+
+bool SaoFU::ingest_event(IngestContext& context, const EventRecord& e) {
+    if (context.verbose) {
+        wstring file_time = formatFileTimeToSQLDateTime((const FILETIME*)&e.timestamp);
+        wprintf(L"\n=== New Event Received ===\n");
+        wprintf(L"Provider: %s | EventID: %u  | Time: %s\n",
+            e.provider.c_str(), //來源
+            e.event_id,         //事件識別碼
+            file_time.c_str()   //日期和時間
+        );
+    }
+
+    // 彙總中的重複事件只計數，第一次出現仍立即寫入讓告警不延遲
+    if (context.aggregator && !context.aggregator->observe(e.provider, e.event_id, e.task, e.message, e.timestamp)) {
+        return false;
+    }
+    if (!context.db) {
+        return true;
+    }
+
+    lock_guard<std::mutex> lock(context.db_mutex);
+    context.db->insert_identity_key(
+    context.table, 
+    L"關鍵字,日期和時間,事件識別碼,來源,工作類別,內容,LogDate",
+        e.keyword,
+        *(const FILETIME*)&e.timestamp,
+        e.event_id,
+        e.task,
+        e.keyword,
+        e.message,
+        (SQLCMD)L"SYSDATETIME()"
+    );
+    return true;
+}
+
+void SaoFU::insert_summaries(IngestContext& context, const vector<AggregatedEvent>& summaries) {
+    if (!context.db || summaries.empty()) {
+        return;
+    }
+
+    lock_guard<std::mutex> lock(context.db_mutex);
+    for (const AggregatedEvent& e : summaries) {
+        context.db->insert_identity_key(
+            context.summary_table,
+            L"來源,事件識別碼,工作類別,內容,首次時間,最後時間,次數,LogDate",
+            e.provider,
+            e.event_id,
+            e.task,
+            e.message,
+            *(const FILETIME*)&e.first_seen,
+            *(const FILETIME*)&e.last_seen,
+            (int64_t)e.count,
+            (SQLCMD)L"SYSDATETIME()"
+        );
+    }
+}
+
+thread SaoFU::start_summary_flusher(IngestContext& context) {
+    if (!context.aggregator) {
+        return thread();
+    }
+
+    context.stopping = false;
+    return thread([&context] {
+        unique_lock<std::mutex> lock(context.flush_mutex);
+        while (!context.flush_cv.wait_for(lock, chrono::seconds(1), [&context] { return context.stopping; })) {
+            lock.unlock();
+            insert_summaries(context, context.aggregator->expire(context.aggregator->clock()));
+            lock.lock();
+        }
+    });
+}
+
+void SaoFU::stop_summary_flusher(IngestContext& context, thread& flusher) {
+    if (!flusher.joinable()) {
+        return;
+    }
+    {
+        lock_guard<std::mutex> lock(context.flush_mutex);
+        context.stopping = true;
+    }
+    context.flush_cv.notify_all();
+    flusher.join();
+    insert_summaries(context, context.aggregator->flush_all());
+}
+
+int SaoFU::shed_rank(const EventRecord& e, const OverloadOptions& options) {
+    // LogAlways（0）多半是傳統來源與稽核事件，當成 Information
+    int level = e.level == 0 ? 4 : min<int>(e.level, 5);
+    if (level <= options.protected_level) {
+        return 0;
+    }
+    for (const wstring& keyword : options.keep_keywords) {
+        if (e.keyword == keyword) {
+            return 0;
+        }
+    }
+    return level;
+}
+
+static const wchar_t* policyName(OverloadPolicy policy) {
+    switch (policy) {
+    case OverloadPolicy::Block: return L"block";
+    case OverloadPolicy::Drop: return L"drop";
+    case OverloadPolicy::Shed: return L"shed";
+    case OverloadPolicy::Sample: return L"sample";
+    }
+    return L"?";
+}
+
+void SaoFU::print_overload_stats(const OverloadStats& stats) {
+    static const wchar_t* levels[] = { L"LogAlways", L"Critical", L"Error", L"Warning", L"Information", L"Verbose" };
+
+    wcout << L"Ingest queue: accepted " << stats.accepted << L", dropped " << stats.dropped
+        << L", shed " << stats.shed << L", sampled " << stats.sampled
+        << L", blocked " << stats.blocked << L" (" << stats.blocked_seconds << L" s)"
+        << L", overloads " << stats.overload_episodes << L", peak " << stats.high_water << L"\n";
+    if (stats.lost() == 0) {
+        return;
+    }
+    wcout << L"Lost by level:";
+    for (int i = 0; i < 6; ++i) {
+        if (stats.lost_by_level[i] > 0) {
+            wcout << L" " << levels[i] << L" " << stats.lost_by_level[i];
+        }
+    }
+    wcout << L"\n";
+}
+
+// 水位不合理時收斂到 capacity 以內，low 不高於 high
+static OverloadOptions normalized(OverloadOptions o) {
+    o.capacity = max<size_t>(o.capacity, 1);
+    o.high_watermark = min(max<size_t>(o.high_watermark, 1), o.capacity);
+    o.low_watermark = min(o.low_watermark, o.high_watermark);
+    o.latency_low = min(o.latency_low, o.latency_high);
+    o.sample_every = max<size_t>(o.sample_every, 1);
+    return o;
+}
+
+IngestQueue::IngestQueue(OverloadOptions options) : opts(normalized(move(options))) {}
+
+void IngestQueue::update_overload(chrono::steady_clock::time_point now) {
+    const size_t depth = items.size();
+    const auto age = items.empty() ? chrono::steady_clock::duration::zero() : now - items.front().enqueued;
+
+    if (!counters.overloaded && (depth >= opts.high_watermark || age >= opts.latency_high)) {
+        counters.overloaded = true;
+        counters.overload_episodes++;
+        if (opts.report_transitions) {
+            wcerr << L"Ingest overload (" << policyName(opts.policy) << L"): depth " << depth << L", oldest "
+                << chrono::duration_cast<chrono::milliseconds>(age).count() << L" ms\n";
+        }
+    }
+    else if (counters.overloaded && depth <= opts.low_watermark && age <= opts.latency_low) {
+        counters.overloaded = false;
+        if (opts.report_transitions) {
+            wcerr << L"Ingest overload cleared: dropped " << counters.dropped << L", shed " << counters.shed
+                << L", sampled " << counters.sampled << L" so far\n";
+        }
+    }
+}
+
+int IngestQueue::shed_threshold() const {
+    if (!counters.overloaded) {
+        return 6;
+    }
+    // 高水位只丟 Verbose，越接近上限越往 Warning 推；受保護的等級不在範圍內
+    const int lowest = min(max<int>(opts.protected_level + 1, 1), 5);
+    const size_t depth = items.size();
+    double fraction = 0;
+    if (depth > opts.high_watermark && opts.capacity > opts.high_watermark) {
+        fraction = (double)(depth - opts.high_watermark) / (opts.capacity - opts.high_watermark);
+    }
+    int threshold = 5 - (int)(min(fraction, 1.0) * (5 - lowest + 1));
+    return max(threshold, lowest);
+}
+
+bool IngestQueue::evict_below(int rank) {
+    for (int r = 5; r > rank; --r) {
+        if (queued_by_rank[r] == 0) {
+            continue;
+        }
+        // 擠掉最新的一筆，較舊的已經等了比較久
+        for (auto it = items.end(); it != items.begin();) {
+            --it;
+            if (it->rank == r) {
+                count_lost(it->event, counters.shed);
+                counters.accepted--;
+                queued_by_rank[r]--;
+                items.erase(it);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void IngestQueue::count_lost(const EventRecord& e, uint64_t& counter) {
+    counter++;
+    counters.lost_by_level[min<int>(e.level, 5)]++;
+}
+
+bool IngestQueue::push(EventRecord&& e) {
+    {
+        unique_lock<std::mutex> lock(mutex);
+        if (closed) {
+            return false;
+        }
+        update_overload(chrono::steady_clock::now());
+
+        const int rank = shed_rank(e, opts);
+        if (opts.policy == OverloadPolicy::Shed && rank > 0 && rank >= shed_threshold()) {
+            count_lost(e, counters.shed);
+            return false;
+        }
+        if (opts.policy == OverloadPolicy::Sample && rank > 0 && counters.overloaded
+            && sample_counter[rank]++ % opts.sample_every != 0) {
+            count_lost(e, counters.sampled);
+            return false;
+        }
+
+        if (items.size() >= opts.capacity) {
+            if (opts.policy == OverloadPolicy::Drop) {
+                count_lost(e, counters.dropped);
+                return false;
+            }
+            if (opts.policy == OverloadPolicy::Shed && !evict_below(rank) && rank > 0) {
+                count_lost(e, counters.shed);
+                return false;
+            }
+            if (opts.policy == OverloadPolicy::Sample && rank > 0) {
+                count_lost(e, counters.dropped);
+                return false;
+            }
+        }
+
+        if (items.size() >= opts.capacity) {
+            counters.blocked++;
+            const auto start = chrono::steady_clock::now();
+            not_full.wait(lock, [this] { return closed || items.size() < opts.capacity; });
+            counters.blocked_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            if (closed) {
+                return false;
+            }
+        }
+
+        items.push_back({ move(e), chrono::steady_clock::now(), rank });
+        queued_by_rank[rank]++;
+        counters.accepted++;
+        counters.high_water = max(counters.high_water, items.size());
+    }
+    not_empty.notify_one();
+    return true;
+}
+
+bool IngestQueue::pop(EventRecord& out) {
+    {
+        unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return false;
+        }
+        out = move(items.front().event);
+        queued_by_rank[items.front().rank]--;
+        items.pop_front();
+        update_overload(chrono::steady_clock::now());
+    }
+    not_full.notify_one();
+    return true;
+}
+
+void IngestQueue::close() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    not_empty.notify_all();
+    not_full.notify_all();
+}
+
+size_t IngestQueue::size() const {
+    lock_guard<std::mutex> lock(mutex);
+    return items.size();
+}
+
+size_t IngestQueue::high_water() const {
+    lock_guard<std::mutex> lock(mutex);
+    return counters.high_water;
+}
+
+OverloadStats IngestQueue::stats() const {
+    lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
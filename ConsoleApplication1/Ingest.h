@@ -0,0 +1,126 @@
+﻿// Ingest.h
+#ifndef INGEST_H
+#define INGEST_H
+
+#include "DatabaseAccess.h"
+#include "EventAggregator.h"
+#include "EventSource.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SaoFU {
+    // 事件來源與彙總執行緒共用的寫入狀態
+    // aggregator 為 nullptr 時每個事件都直接寫入；db 為 nullptr 時只跑彙總不寫入（負載測試的 dry run）
+    struct IngestContext {
+        DatabaseAccess* db = nullptr;
+        std::unique_ptr<EventAggregator> aggregator;
+        std::wstring table = L"event.dbo.even";
+        std::wstring summary_table = L"event.dbo.even_summary";
+        bool verbose = true;  // 每筆事件印一行
+        std::mutex db_mutex;  // DatabaseAccess 不是執行緒安全的
+
+        std::mutex flush_mutex;
+        std::condition_variable flush_cv;
+        bool stopping = false;
+    };
+
+    // 回傳 true 表示已寫入（dry run 時表示應寫入）；被彙總壓下時回傳 false
+    bool ingest_event(IngestContext& context, const EventRecord& e);
+    void insert_summaries(IngestContext& context, const std::vector<AggregatedEvent>& summaries);
+
+    // 每秒寫出結束的視窗；stop_summary_flusher() 會把剩下的全部寫出後才返回
+    std::thread start_summary_flusher(IngestContext& context);
+    void stop_summary_flusher(IngestContext& context, std::thread& flusher);
+
+    // 佇列超過水位時的處理方式
+    enum class OverloadPolicy {
+        Block,   // 不丟事件，滿了讓來源等待；事件記錄在系統的 log 裡，訂閱只是落後
+        Drop,    // 滿了就丟掉新事件，不分等級
+        Shed,    // 過載時依等級從 Verbose 往上丟，滿了會擠掉佇列裡較低優先的事件
+        Sample,  // 過載時非保護等級每 sample_every 筆只留一筆
+    };
+
+    struct OverloadOptions {
+        OverloadPolicy policy = OverloadPolicy::Block;
+        std::size_t capacity = 10000;                       // 硬上限，任何策略都不會超過
+        // 深度或最舊事件的等待時間超過 high 進入過載，兩者都回到 low 以下才解除
+        std::size_t high_watermark = 8000;
+        std::size_t low_watermark = 2000;
+        std::chrono::milliseconds latency_high{ 2000 };
+        std::chrono::milliseconds latency_low{ 500 };
+        // 這個等級以下（含）與 keep_keywords 的事件不被 Shed / Sample 丟棄，滿了就等待
+        BYTE protected_level = 2;
+        std::vector<std::wstring> keep_keywords = { L"Audit Failure" };
+        std::size_t sample_every = 10;
+        bool report_transitions = true;                     // 進入、解除過載時寫到 wcerr
+    };
+
+    struct OverloadStats {
+        std::uint64_t accepted = 0;         // 會交給寫入端的筆數，不含之後被擠出佇列的
+        std::uint64_t dropped = 0;          // 佇列滿了丟棄
+        std::uint64_t shed = 0;             // Shed 依等級丟棄，含被擠出佇列的
+        std::uint64_t sampled = 0;          // Sample 抽樣略過
+        std::uint64_t blocked = 0;          // 來源等待空位的次數
+        double blocked_seconds = 0;
+        std::uint64_t overload_episodes = 0;
+        bool overloaded = false;
+        std::uint64_t lost_by_level[6] = {};  // dropped + shed + sampled，依等級；超過 5 的算在 5
+        std::size_t high_water = 0;
+
+        std::uint64_t lost() const { return dropped + shed + sampled; }
+    };
+
+    // 一行計數，有遺失時再加一行依等級的分布
+    void print_overload_stats(const OverloadStats& stats);
+
+    // Shed 的丟棄順序：0 表示受保護，數字越大越先丟
+    int shed_rank(const EventRecord& e, const OverloadOptions& options);
+
+    // 有上限的 FIFO，來源執行緒放入、寫入執行緒取出；放入時依 OverloadOptions 決定收、丟或等待
+    class IngestQueue {
+    public:
+        explicit IngestQueue(OverloadOptions options);
+
+        // 回傳 false 表示事件沒進佇列（被丟棄，或已 close()）
+        bool push(EventRecord&& e);
+        // 等到有事件；已 close() 且清空時回傳 false
+        bool pop(EventRecord& out);
+        void close();
+
+        std::size_t size() const;
+        std::size_t high_water() const;
+        OverloadStats stats() const;
+    private:
+        struct Entry {
+            EventRecord event;
+            std::chrono::steady_clock::time_point enqueued;
+            int rank;
+        };
+
+        // 以下都在持有 mutex 時呼叫
+        void update_overload(std::chrono::steady_clock::time_point now);
+        int shed_threshold() const;
+        bool evict_below(int rank);
+        void count_lost(const EventRecord& e, std::uint64_t& counter);
+
+        const OverloadOptions opts;
+        mutable std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::deque<Entry> items;
+        std::size_t queued_by_rank[6] = {};
+        std::uint64_t sample_counter[6] = {};
+        OverloadStats counters;
+        bool closed = false;
+    };
+}
+
+#endif // INGEST_H
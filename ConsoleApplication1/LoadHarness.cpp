@@ -0,0 +1,80 @@
+﻿#include "LoadHarness.h"
+
+#include "DataBaseException.h"
+
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace SaoFU;
+using namespace std;
+
+LoadReport SaoFU::run_load(EventSource& source, IngestContext& context, const LoadOptions& options) {
+    using clock = chrono::steady_clock;
+
+    LoadReport report;
+    LatencyHistogram latency;
+    IngestQueue queue(options.overload);
+
+    thread flusher = start_summary_flusher(context);
+    const auto start = clock::now();
+
+    thread writer([&] {
+        EventRecord e;
+        while (queue.pop(e)) {
+            try {
+                if (ingest_event(context, e)) report.inserted++;
+                else report.suppressed++;
+            }
+            catch (const DataBaseException&) {
+                report.failed++;
+                continue;
+            }
+            catch (const exception&) {
+                // MemoryLimitExceeded 等；例外離開 std::thread 會直接 terminate
+                report.failed++;
+                continue;
+            }
+            latency.record((uint64_t)chrono::duration_cast<chrono::nanoseconds>(clock::now() - e.created).count());
+        }
+    });
+
+    try {
+        source.run([&](EventRecord&& e) {
+            report.produced++;
+            queue.push(move(e));
+        });
+    }
+    catch (...) {
+        queue.close();
+        writer.join();
+        stop_summary_flusher(context, flusher);
+        throw;
+    }
+
+    queue.close();
+    writer.join();
+    report.seconds = chrono::duration<double>(clock::now() - start).count();
+    stop_summary_flusher(context, flusher);
+
+    report.overload = queue.stats();
+    report.latency = latency.snapshot();
+    return report;
+}
+
+void SaoFU::print_load_report(const LoadReport& report) {
+    auto ms = [](uint64_t ns) { return ns / 1e6; };
+
+    wcout << fixed << setprecision(2)
+        << L"Produced:   " << report.produced << L"\n"
+        << L"Inserted:   " << report.inserted << L"\n"
+        << L"Suppressed: " << report.suppressed << L"\n"
+        << L"Failed:     " << report.failed << L"\n"
+        << L"Elapsed:    " << report.seconds << L" s\n"
+        << L"Throughput: " << report.events_per_second() << L" events/s\n"
+        << L"Latency ms: p50 " << ms(report.latency.percentile_ns(50))
+        << L"  p95 " << ms(report.latency.percentile_ns(95))
+        << L"  p99 " << ms(report.latency.percentile_ns(99))
+        << L"  max " << ms(report.latency.max_ns) << L"\n";
+    print_overload_stats(report.overload);
+}
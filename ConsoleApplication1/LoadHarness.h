@@ -0,0 +1,34 @@
+﻿// LoadHarness.h
+#ifndef LOAD_HARNESS_H
+#define LOAD_HARNESS_H
+
+#include "EventSource.h"
+#include "Ingest.h"
+#include "QueryStats.h"
+
+#include <cstdint>
+
+namespace SaoFU {
+    struct LoadOptions {
+        // 預設 Drop：佇列滿了就丟掉事件（量測系統跟不跟得上）；不限速重播時改用 Block
+        OverloadOptions overload = { OverloadPolicy::Drop };
+    };
+
+    struct LoadReport {
+        std::uint64_t produced = 0;
+        std::uint64_t inserted = 0;
+        std::uint64_t suppressed = 0;
+        std::uint64_t failed = 0;          // 寫入時丟出例外
+        OverloadStats overload;            // 丟棄、抽樣與等待的計數，以及佇列峰值
+        double seconds = 0;
+        HistogramSnapshot latency;         // 來源產生到寫入完成，單位 ns
+
+        double events_per_second() const { return seconds > 0 ? (inserted + suppressed) / seconds : 0; }
+    };
+
+    // 來源在目前執行緒產生事件，另一條寫入執行緒透過 ingest_event() 寫入，直到來源結束且佇列清空
+    LoadReport run_load(EventSource& source, IngestContext& context, const LoadOptions& options = {});
+    void print_load_report(const LoadReport& report);
+}
+
+#endif // LOAD_HARNESS_H
@@ -0,0 +1,228 @@
+﻿#include "MemoryAccounting.h"
+
+#include <iostream>
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    // MSVC 的 unordered_map 是一條雙向 list（含一個 sentinel 節點）加上每個 bucket 兩個 iterator
+    template<typename Map>
+    size_t map_node_bytes() {
+        return heap_bytes(sizeof(typename Map::value_type) + 2 * sizeof(void*));
+    }
+
+    template<typename Map>
+    size_t map_fixed_bytes(const Map& map) {
+        return sizeof(Map) + map_node_bytes<Map>() + heap_bytes(2 * map.bucket_count() * sizeof(void*));
+    }
+
+    template<typename Row>
+    MemoryUsage table_usage(const vector<Row>& table) {
+        MemoryUsage usage;
+        for (const Row& row : table) {
+            usage += memory_usage(row);
+        }
+        // 每列的 sizeof(Row) 已算在 memory_usage(row)，這裡只加 vector 本身與未使用的容量
+        usage.overhead += sizeof(vector<Row>) + (table.capacity() - table.size()) * sizeof(Row);
+        if (table.capacity() > 0) {
+            usage.overhead += heap_bytes(table.capacity() * sizeof(Row)) - table.capacity() * sizeof(Row);
+        }
+        return usage;
+    }
+}
+
+// x64 CRT heap 的配置粒度為 16 位元組
+size_t SaoFU::heap_bytes(size_t n) {
+    return n ? (n + 15) & ~size_t(15) : 0;
+}
+
+size_t SaoFU::heap_bytes(const wstring& s) {
+    return s.capacity() > 7 ? heap_bytes((s.capacity() + 1) * sizeof(wchar_t)) : 0;
+}
+
+size_t SaoFU::heap_bytes(const string& s) {
+    return s.capacity() > 15 ? heap_bytes(s.capacity() + 1) : 0;
+}
+
+MemoryUsage& MemoryUsage::operator+=(const MemoryUsage& other) {
+    payload += other.payload;
+    metadata += other.metadata;
+    overhead += other.overhead;
+    return *this;
+}
+
+MemoryUsage SaoFU::memory_usage(const DataRow& row) {
+    const size_t node_bytes = map_node_bytes<DataRow>();
+    const size_t meta_in_node = sizeof(wstring) + sizeof(ColumnMeta);
+
+    MemoryUsage usage;
+    usage.overhead = map_fixed_bytes(row);
+    for (const auto& kv : row) {
+        usage.payload += heap_bytes(kv.second.buffer.capacity());
+        usage.metadata += meta_in_node + heap_bytes(kv.first) + heap_bytes(kv.second.meta.name);
+        usage.overhead += node_bytes - meta_in_node;
+    }
+    return usage;
+}
+
+MemoryUsage SaoFU::memory_usage(const DataTable& table) {
+    return table_usage(table);
+}
+
+MemoryUsage SaoFU::memory_usage(const Utf8Row& row) {
+    const size_t node_bytes = map_node_bytes<Utf8Row>();
+
+    MemoryUsage usage;
+    usage.overhead = map_fixed_bytes(row);
+    for (const auto& kv : row) {
+        usage.payload += heap_bytes(kv.second.data);
+        usage.metadata += sizeof(string) + heap_bytes(kv.first);
+        usage.overhead += node_bytes - sizeof(string);
+    }
+    return usage;
+}
+
+MemoryUsage SaoFU::memory_usage(const Utf8Table& table) {
+    return table_usage(table);
+}
+
+void MemoryCounter::set_limits(const MemoryLimits& limits) {
+    soft_bytes.store(limits.soft_bytes, memory_order_relaxed);
+    hard_bytes.store(limits.hard_bytes, memory_order_relaxed);
+}
+
+bool MemoryCounter::add(size_t bytes) {
+    const size_t now = live.fetch_add(bytes, memory_order_relaxed) + bytes;
+
+    const size_t hard = hard_bytes.load(memory_order_relaxed);
+    if (hard && now > hard) {
+        live.fetch_sub(bytes, memory_order_relaxed);
+        hard_limit_hits.fetch_add(1, memory_order_relaxed);
+        throw MemoryLimitExceeded("Result memory hard limit exceeded on " + name + ": "
+                                  + to_string(now) + " > " + to_string(hard) + " bytes", now, hard);
+    }
+
+    size_t p = peak.load(memory_order_relaxed);
+    while (now > p && !peak.compare_exchange_weak(p, now, memory_order_relaxed)) {
+    }
+
+    const size_t soft = soft_bytes.load(memory_order_relaxed);
+    if (soft && now > soft && now - bytes <= soft) {
+        soft_limit_hits.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void MemoryCounter::sub(size_t bytes) noexcept {
+    live.fetch_sub(bytes, memory_order_relaxed);
+}
+
+void MemoryCounter::reset_peak() noexcept {
+    peak.store(live.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+void ConnectionMemory::set_database(const wstring& name) {
+    lock_guard<std::mutex> lock(mutex);
+    database = name;
+}
+
+ConnectionMemoryStats ConnectionMemory::snapshot() const {
+    ConnectionMemoryStats s;
+    s.id = id;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        s.database = database;
+    }
+    s.live_bytes = live.load(memory_order_relaxed);
+    s.peak_bytes = peak.load(memory_order_relaxed);
+    s.soft_limit_hits = soft_limit_hits.load(memory_order_relaxed);
+    s.hard_limit_hits = hard_limit_hits.load(memory_order_relaxed);
+    return s;
+}
+
+MemoryTracker& MemoryTracker::instance() {
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+shared_ptr<ConnectionMemory> MemoryTracker::register_connection() {
+    lock_guard<std::mutex> lock(mutex);
+    auto connection = make_shared<ConnectionMemory>(next_id++);
+
+    // 順便清掉已經解構的連線，避免長時間執行時清單一直變長
+    erase_if(connections, [](const weak_ptr<ConnectionMemory>& w) { return w.expired(); });
+    connections.push_back(connection);
+    return connection;
+}
+
+void MemoryTracker::set_limits(const MemoryLimits& limits) {
+    total.set_limits(limits);
+}
+
+MemoryStats MemoryTracker::stats() const {
+    MemoryStats s;
+    s.live_bytes = total.live.load(memory_order_relaxed);
+    s.peak_bytes = total.peak.load(memory_order_relaxed);
+    s.soft_limit_hits = total.soft_limit_hits.load(memory_order_relaxed);
+    s.hard_limit_hits = total.hard_limit_hits.load(memory_order_relaxed);
+
+    lock_guard<std::mutex> lock(mutex);
+    for (const auto& w : connections) {
+        if (auto connection = w.lock()) {
+            s.connections.push_back(connection->snapshot());
+        }
+    }
+    return s;
+}
+
+void MemoryTracker::reset_peaks() {
+    total.reset_peak();
+    lock_guard<std::mutex> lock(mutex);
+    for (const auto& w : connections) {
+        if (auto connection = w.lock()) {
+            connection->reset_peak();
+        }
+    }
+}
+
+MemoryReservation::MemoryReservation(ConnectionMemory* connection) : connection(connection) {}
+
+MemoryReservation::~MemoryReservation() {
+    release();
+}
+
+void MemoryReservation::add(size_t bytes) {
+    MemoryCounter& process = MemoryTracker::instance().process();
+    bool soft = false;
+
+    if (connection) {
+        soft = connection->add(bytes);
+    }
+    try {
+        soft = process.add(bytes) || soft;
+    }
+    catch (const MemoryLimitExceeded&) {
+        if (connection) connection->sub(bytes);
+        throw;
+    }
+    reserved += bytes;
+
+    // 同一次查詢只警告一次
+    if (soft && !warned) {
+        warned = true;
+        wcerr << L"Result memory soft limit exceeded";
+        if (connection) wcerr << L" on connection #" << connection->id;
+        wcerr << L": " << reserved << L" bytes in this result\n";
+    }
+}
+
+void MemoryReservation::release() noexcept {
+    if (reserved == 0) {
+        return;
+    }
+    if (connection) connection->sub(reserved);
+    MemoryTracker::instance().process().sub(reserved);
+    reserved = 0;
+}
@@ -0,0 +1,146 @@
+﻿// MemoryAccounting.h
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include "DataTable.h"
+#include "Utf8.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace SaoFU {
+    // 結果在 heap 上的實際占用，依 MSVC x64 的容器配置計算，每次配置以 16 位元組對齊
+    struct MemoryUsage {
+        std::size_t payload = 0;   // cell 資料：vector<BYTE> / std::string 配置的容量
+        std::size_t metadata = 0;  // 每格重複的欄名（map key 與 ColumnMeta::name）與 ColumnMeta 本身
+        std::size_t overhead = 0;  // 雜湊表節點、bucket 陣列、vector 未使用的容量與對齊
+
+        std::size_t total() const { return payload + metadata + overhead; }
+        MemoryUsage& operator+=(const MemoryUsage& other);
+    };
+
+    // 單次配置 n 位元組實際占用的 heap；字串只計超出 SSO（wstring 7、string 15 個字元）的部分
+    std::size_t heap_bytes(std::size_t n);
+    std::size_t heap_bytes(const std::wstring& s);
+    std::size_t heap_bytes(const std::string& s);
+
+    MemoryUsage memory_usage(const DataRow& row);
+    MemoryUsage memory_usage(const DataTable& table);
+    MemoryUsage memory_usage(const Utf8Row& row);
+    MemoryUsage memory_usage(const Utf8Table& table);
+
+    // 0 表示不限制；超過 soft 時記錄一次警告並計數，超過 hard 時丟 MemoryLimitExceeded
+    struct MemoryLimits {
+        std::size_t soft_bytes = 0;
+        std::size_t hard_bytes = 0;
+    };
+
+    class MemoryLimitExceeded : public std::runtime_error {
+    public:
+        MemoryLimitExceeded(const std::string& message, std::size_t requested, std::size_t limit)
+            : std::runtime_error(message), requested(requested), limit(limit) {}
+
+        std::size_t requested; // 加上這一筆之後的總量
+        std::size_t limit;
+    };
+
+    struct ConnectionMemoryStats {
+        std::uint64_t id = 0;
+        std::wstring database;
+        std::size_t live_bytes = 0;
+        std::size_t peak_bytes = 0;
+        std::uint64_t soft_limit_hits = 0;
+        std::uint64_t hard_limit_hits = 0;
+    };
+
+    struct MemoryStats {
+        std::size_t live_bytes = 0;
+        std::size_t peak_bytes = 0;
+        std::uint64_t soft_limit_hits = 0;
+        std::uint64_t hard_limit_hits = 0;
+        std::vector<ConnectionMemoryStats> connections; // 目前還存在的連線
+    };
+
+    // 一組 live / peak 計數與上限；行程整體一份，每條連線各一份
+    class MemoryCounter {
+    public:
+        explicit MemoryCounter(std::string name) : name(std::move(name)) {}
+
+        const std::string name; // 例外訊息用
+        std::atomic<std::size_t> live{ 0 };
+        std::atomic<std::size_t> peak{ 0 };
+        std::atomic<std::size_t> soft_bytes{ 0 };
+        std::atomic<std::size_t> hard_bytes{ 0 };
+        std::atomic<std::uint64_t> soft_limit_hits{ 0 };
+        std::atomic<std::uint64_t> hard_limit_hits{ 0 };
+
+        void set_limits(const MemoryLimits& limits);
+        // 超過 hard 時不計入並丟 MemoryLimitExceeded；回傳 true 表示這一筆越過了 soft
+        bool add(std::size_t bytes);
+        void sub(std::size_t bytes) noexcept;
+        void reset_peak() noexcept;
+    };
+
+    // 由 DatabaseAccess 持有，移動連線時跟著移動
+    class ConnectionMemory : public MemoryCounter {
+    public:
+        explicit ConnectionMemory(std::uint64_t id) : MemoryCounter("connection #" + std::to_string(id)), id(id) {}
+
+        const std::uint64_t id;
+
+        void set_database(const std::wstring& name);
+        ConnectionMemoryStats snapshot() const;
+    private:
+        mutable std::mutex mutex;
+        std::wstring database;
+    };
+
+    // 計的是「組裝中」的結果：command() 取列期間逐列累加，回傳或丟例外時歸還
+    // 結果交給呼叫端之後不再追蹤，因此 peak_bytes 即單次（或同時進行的）查詢結果的最大占用
+    class MemoryTracker {
+    public:
+        static MemoryTracker& instance();
+
+        std::shared_ptr<ConnectionMemory> register_connection();
+        // 行程整體的上限，與各連線自己的上限同時生效
+        void set_limits(const MemoryLimits& limits);
+        MemoryStats stats() const;
+        void reset_peaks();
+
+        MemoryCounter& process() { return total; }
+    private:
+        MemoryTracker() = default;
+
+        mutable std::mutex mutex;
+        std::vector<std::weak_ptr<ConnectionMemory>> connections;
+        std::uint64_t next_id = 1;
+        MemoryCounter total{ "process" };
+    };
+
+    // 單次查詢的計帳；解構時把累加的位元組全部歸還
+    class MemoryReservation {
+    public:
+        explicit MemoryReservation(ConnectionMemory* connection);
+        ~MemoryReservation();
+
+        MemoryReservation(const MemoryReservation&) = delete;
+        MemoryReservation& operator=(const MemoryReservation&) = delete;
+
+        // 超過連線或行程的 hard 上限時丟 MemoryLimitExceeded，這一筆不計入
+        void add(std::size_t bytes);
+        // 重試前歸零
+        void release() noexcept;
+        std::size_t bytes() const { return reserved; }
+    private:
+        ConnectionMemory* connection;
+        std::size_t reserved = 0;
+        bool warned = false;
+    };
+}
+
+#endif // MEMORY_ACCOUNTING_H
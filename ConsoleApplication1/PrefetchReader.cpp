@@ -0,0 +1,203 @@
+﻿#include "PrefetchReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    constexpr size_t no_block = SIZE_MAX;
+
+    // 由 sink 丟出，讓 producer 在 stop() 後盡快離開
+    struct PrefetchStopped {};
+
+    double seconds_since(chrono::steady_clock::time_point start) {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+struct PrefetchReader::State {
+    PrefetchOptions options;
+    vector<DataTable> blocks;      // 建構後不再改變大小，區塊由索引在兩條執行緒間交接
+    deque<size_t> free_blocks;
+    deque<size_t> filled_blocks;
+    size_t current = no_block;     // 目前交給消費端的區塊
+
+    mutable std::mutex mutex;
+    condition_variable cv;
+    atomic<bool> stopping{ false };
+    bool done = false;
+    exception_ptr error;
+    CancellationToken cancel;
+
+    PrefetchStats stats;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    thread worker;
+
+    void run(const Producer& producer);
+};
+
+void PrefetchReader::State::run(const Producer& producer) {
+    size_t filling = no_block;
+
+    auto acquire = [&] {
+        auto wait_start = chrono::steady_clock::now();
+        unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return stopping || !free_blocks.empty(); });
+        stats.producer_stall_seconds += seconds_since(wait_start);
+        if (stopping) {
+            throw PrefetchStopped{};
+        }
+        filling = free_blocks.front();
+        free_blocks.pop_front();
+        lock.unlock();
+
+        // 在背景執行緒釋放上一輪的列，保留 vector 容量
+        blocks[filling].clear();
+    };
+
+    auto publish = [&] {
+        lock_guard<std::mutex> lock(mutex);
+        stats.rows += blocks[filling].size();
+        ++stats.blocks;
+        filled_blocks.push_back(filling);
+        filling = no_block;
+        cv.notify_all();
+    };
+
+    try {
+        producer([&](DataRow&& row) {
+            if (stopping.load(memory_order_relaxed)) {
+                throw PrefetchStopped{};
+            }
+            if (filling == no_block) {
+                acquire();
+            }
+            blocks[filling].emplace_back(move(row));
+            if (blocks[filling].size() >= options.block_rows) {
+                publish();
+            }
+        }, cancel);
+
+        if (filling != no_block) {
+            publish();
+        }
+    }
+    catch (const PrefetchStopped&) {
+    }
+    catch (...) {
+        lock_guard<std::mutex> lock(mutex);
+        if (!stopping) {
+            error = current_exception();
+        }
+    }
+
+    lock_guard<std::mutex> lock(mutex);
+    done = true;
+    cv.notify_all();
+}
+
+PrefetchReader::PrefetchReader(Producer producer, const PrefetchOptions& options) : state(make_unique<State>()) {
+    state->options = options;
+    state->options.block_rows = max<size_t>(options.block_rows, 1);
+    state->options.depth = max<size_t>(options.depth, 2);
+
+    state->blocks.resize(state->options.depth);
+    for (size_t i = 0; i < state->blocks.size(); ++i) {
+        state->blocks[i].reserve(state->options.block_rows);
+        state->free_blocks.push_back(i);
+    }
+
+    State* s = state.get();
+    state->worker = thread([s, producer = move(producer)] { s->run(producer); });
+}
+
+PrefetchReader::~PrefetchReader() {
+    stop();
+}
+
+PrefetchReader::PrefetchReader(PrefetchReader&& other) noexcept : state(move(other.state)) {
+}
+
+PrefetchReader& PrefetchReader::operator=(PrefetchReader&& other) noexcept {
+    if (this != &other) {
+        stop();
+        state = move(other.state);
+    }
+    return *this;
+}
+
+const DataTable* PrefetchReader::next_block() {
+    if (!state) {
+        return nullptr;
+    }
+    State& s = *state;
+
+    unique_lock<std::mutex> lock(s.mutex);
+    if (s.current != no_block) {
+        s.free_blocks.push_back(s.current);
+        s.current = no_block;
+        s.cv.notify_all();
+    }
+
+    if (s.filled_blocks.empty() && !s.done) {
+        auto wait_start = chrono::steady_clock::now();
+        s.cv.wait(lock, [&] { return !s.filled_blocks.empty() || s.done; });
+        s.stats.consumer_stall_seconds += seconds_since(wait_start);
+    }
+
+    if (!s.filled_blocks.empty()) {
+        s.current = s.filled_blocks.front();
+        s.filled_blocks.pop_front();
+        return &s.blocks[s.current];
+    }
+
+    if (s.stats.wall_seconds == 0) {
+        s.stats.wall_seconds = seconds_since(s.start);
+    }
+    if (s.error) {
+        exception_ptr e = s.error;
+        s.error = nullptr;
+        rethrow_exception(e);
+    }
+    return nullptr;
+}
+
+void PrefetchReader::stop() {
+    if (!state || !state->worker.joinable()) {
+        return;
+    }
+    {
+        lock_guard<std::mutex> lock(state->mutex);
+        if (!state->done) {
+            state->stopping = true;
+        }
+        state->cv.notify_all();
+    }
+    if (state->stopping) {
+        state->cancel.cancel();
+    }
+    state->worker.join();
+
+    // 已停止的 reader 不再交出剩下的區塊
+    lock_guard<std::mutex> lock(state->mutex);
+    if (state->stopping) {
+        state->filled_blocks.clear();
+    }
+}
+
+PrefetchStats PrefetchReader::stats() const {
+    if (!state) {
+        return {};
+    }
+    lock_guard<std::mutex> lock(state->mutex);
+    return state->stats;
+}
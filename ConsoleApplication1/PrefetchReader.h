@@ -0,0 +1,64 @@
+﻿// PrefetchReader.h
+#ifndef PREFETCH_READER_H
+#define PREFETCH_READER_H
+
+#include "CancellationToken.h"
+#include "DataTable.h"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace SaoFU {
+    struct PrefetchOptions {
+        std::size_t block_rows = 1024; // 每個區塊的列數
+        std::size_t depth = 2;         // ring 中的區塊數，至少 2（一塊給消費端、一塊給背景執行緒）
+    };
+
+    struct PrefetchStats {
+        std::size_t rows = 0;
+        std::size_t blocks = 0;
+        double producer_stall_seconds = 0; // 背景執行緒等空區塊：消費端比 driver 慢
+        double consumer_stall_seconds = 0; // 消費端等下一個區塊：driver / 網路比消費端慢
+        double wall_seconds = 0;           // 建構到讀完（next_block() 回傳 nullptr）
+    };
+
+    // 背景執行緒呼叫 producer 取列，依序填入 depth 個重複使用的區塊；消費端處理目前區塊時，下一塊同時在取
+    // ring 全滿時背景執行緒等待消費端歸還區塊（backpressure），記憶體上限為 depth * block_rows 列
+    class PrefetchReader {
+    public:
+        // producer 在背景執行緒執行，每取回一列呼叫一次 sink；cancel 由 stop() 觸發，可交給 QueryOptions::cancel
+        using Producer = std::function<void(const std::function<void(DataRow&&)>& sink, CancellationToken& cancel)>;
+
+        explicit PrefetchReader(Producer producer, const PrefetchOptions& options = {});
+        // 尚未讀完時先 stop()
+        ~PrefetchReader();
+
+        PrefetchReader(PrefetchReader&& other) noexcept;
+        PrefetchReader& operator=(PrefetchReader&& other) noexcept;
+        PrefetchReader(const PrefetchReader&) = delete;
+        PrefetchReader& operator=(const PrefetchReader&) = delete;
+
+        // 歸還上一個區塊並取得下一個，全部讀完時回傳 nullptr；回傳的區塊在下一次呼叫後失效
+        // 背景執行緒丟出的例外會在已完成的區塊都交出之後，由這裡重新丟出
+        const DataTable* next_block();
+
+        template<typename F>
+        void for_each(F&& f) {
+            while (const DataTable* block = next_block()) {
+                for (const DataRow& row : *block) {
+                    f(row);
+                }
+            }
+        }
+
+        // 中止背景執行緒（執行中的查詢會 SQLCancel）並等待它結束；之後 next_block() 回傳 nullptr
+        void stop();
+        PrefetchStats stats() const;
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+    };
+}
+
+#endif // PREFETCH_READER_H
@@ -0,0 +1,338 @@
+﻿#include "QueryStats.h"
+#include "Utf8.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <fstream>
+#include <sstream>
+
+using namespace SaoFU;
+using namespace std;
+
+static int highest_bit(uint64_t v) {
+    int n = 0;
+    while (v >>= 1) {
+        ++n;
+    }
+    return n;
+}
+
+LatencyHistogram::LatencyHistogram() : total_sum(0), max_value(0) {
+    for (auto& c : counts) {
+        c.store(0, memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::bucket_index(uint64_t v) noexcept {
+    const uint64_t sub_count = 1ull << sub_bucket_bits;
+    if (v < sub_count) {
+        return (int)v;
+    }
+    int e = highest_bit(v);
+    int shift = e - sub_bucket_bits;
+    return ((shift + 1) << sub_bucket_bits) + (int)((v >> shift) & (sub_count - 1));
+}
+
+uint64_t LatencyHistogram::bucket_lower_bound(int index) noexcept {
+    const int sub_count = 1 << sub_bucket_bits;
+    if (index < sub_count) {
+        return (uint64_t)index;
+    }
+    int group = index >> sub_bucket_bits;
+    int offset = index & (sub_count - 1);
+    return (uint64_t)(sub_count + offset) << (group - 1);
+}
+
+void LatencyHistogram::record(uint64_t ns) noexcept {
+    counts[bucket_index(ns)].fetch_add(1, memory_order_relaxed);
+    total_sum.fetch_add(ns, memory_order_relaxed);
+
+    uint64_t prev = max_value.load(memory_order_relaxed);
+    while (prev < ns && !max_value.compare_exchange_weak(prev, ns, memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    HistogramSnapshot snap;
+    snap.buckets.resize(bucket_count);
+    for (int i = 0; i < bucket_count; ++i) {
+        snap.buckets[i] = counts[i].load(memory_order_relaxed);
+        snap.count += snap.buckets[i];
+    }
+    snap.sum_ns = total_sum.load(memory_order_relaxed);
+    snap.max_ns = max_value.load(memory_order_relaxed);
+    return snap;
+}
+
+void LatencyHistogram::clear() noexcept {
+    for (auto& c : counts) {
+        c.store(0, memory_order_relaxed);
+    }
+    total_sum.store(0, memory_order_relaxed);
+    max_value.store(0, memory_order_relaxed);
+}
+
+void StatementStats::clear() noexcept {
+    for (LatencyHistogram& h : phases) {
+        h.clear();
+    }
+    executions.store(0, memory_order_relaxed);
+    rows.store(0, memory_order_relaxed);
+    bytes.store(0, memory_order_relaxed);
+    refetches.store(0, memory_order_relaxed);
+    exceptions.store(0, memory_order_relaxed);
+}
+
+double HistogramSnapshot::mean_ns() const {
+    return count ? (double)sum_ns / (double)count : 0.0;
+}
+
+uint64_t HistogramSnapshot::percentile_ns(double p) const {
+    if (count == 0) return 0;
+
+    uint64_t target = (uint64_t)(p / 100.0 * (double)count + 0.5);
+    target = max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= target) {
+            return min(LatencyHistogram::bucket_lower_bound((int)i), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+wstring SaoFU::normalize_statement(const wstring& query) {
+    wstring out;
+    out.reserve(query.size());
+
+    size_t i = 0;
+    const size_t n = query.size();
+    bool pending_space = false;
+
+    auto is_word = [](wchar_t c) { return iswalnum(c) || c == L'_' || c == L'@' || c == L'#'; };
+
+    while (i < n) {
+        wchar_t c = query[i];
+
+        if (iswspace(c)) {
+            pending_space = !out.empty();
+            ++i;
+            continue;
+        }
+        if (pending_space) {
+            out.push_back(L' ');
+            pending_space = false;
+        }
+
+        // 字串常值 '..' 或 N'..'，'' 為跳脫
+        if (c == L'\'' || ((c == L'N' || c == L'n') && i + 1 < n && query[i + 1] == L'\'' && (out.empty() || !is_word(out.back())))) {
+            i += (c == L'\'') ? 1 : 2;
+            while (i < n) {
+                if (query[i] == L'\'') {
+                    if (i + 1 < n && query[i + 1] == L'\'') { i += 2; continue; }
+                    ++i;
+                    break;
+                }
+                ++i;
+            }
+            out.push_back(L'?');
+            continue;
+        }
+
+        // 數字或 0x 常值（識別字中的數字不算）
+        if (iswdigit(c) && (out.empty() || !is_word(out.back()))) {
+            while (i < n && (iswalnum(query[i]) || query[i] == L'.')) {
+                ++i;
+            }
+            out.push_back(L'?');
+            continue;
+        }
+
+        out.push_back(c);
+        ++i;
+    }
+    return out;
+}
+
+QueryStats& QueryStats::instance() {
+    static QueryStats stats;
+    return stats;
+}
+
+StatementStats& QueryStats::statement(const wstring& query) {
+    wstring key = normalize_statement(query);
+
+    lock_guard<std::mutex> lock(mutex);
+    auto it = statements.find(key);
+    if (it != statements.end()) {
+        return *it->second;
+    }
+
+    if (statements.size() >= max_statements) {
+        key = L"(other)";
+        it = statements.find(key);
+        if (it != statements.end()) {
+            return *it->second;
+        }
+    }
+
+    auto stats = make_unique<StatementStats>(key);
+    StatementStats& ref = *stats;
+    statements.emplace(move(key), move(stats));
+    return ref;
+}
+
+StatementStats& QueryStats::statement(const string& utf8_query) {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        auto it = utf8_statements.find(utf8_query);
+        if (it != utf8_statements.end()) {
+            return *it->second;
+        }
+    }
+
+    // 轉碼與正規化在鎖外做；快取上限與 statements 相同，超過後就每次重新轉
+    StatementStats& ref = statement(utf8_to_wide(utf8_query));
+    lock_guard<std::mutex> lock(mutex);
+    if (utf8_statements.size() < max_statements) {
+        utf8_statements.emplace(utf8_query, &ref);
+    }
+    return ref;
+}
+
+vector<StatementSnapshot> QueryStats::stats() const {
+    vector<StatementStats*> entries;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        entries.reserve(statements.size());
+        for (const auto& kv : statements) {
+            entries.push_back(kv.second.get());
+        }
+    }
+
+    // StatementStats 一旦建立就不會被釋放，所以可在鎖外讀取
+    vector<StatementSnapshot> result;
+    result.reserve(entries.size());
+    for (StatementStats* s : entries) {
+        StatementSnapshot snap;
+        snap.statement = s->statement;
+        for (int p = 0; p < (int)QueryPhase::Count; ++p) {
+            snap.phases[p] = s->phases[p].snapshot();
+        }
+        snap.executions = s->executions.load(memory_order_relaxed);
+        snap.rows = s->rows.load(memory_order_relaxed);
+        snap.bytes = s->bytes.load(memory_order_relaxed);
+        snap.refetches = s->refetches.load(memory_order_relaxed);
+        snap.exceptions = s->exceptions.load(memory_order_relaxed);
+        result.emplace_back(move(snap));
+    }
+    return result;
+}
+
+void QueryStats::reset() {
+    lock_guard<std::mutex> lock(mutex);
+    for (auto& kv : statements) {
+        kv.second->clear();
+    }
+}
+
+static void append_json_string(string& out, const wstring& s) {
+    static const char* hex_digits = "0123456789abcdef";
+    out.push_back('"');
+    for (size_t i = 0; i < s.size(); ++i) {
+        uint32_t c = (uint32_t)s[i];
+        if (c == '"' || c == '\\') {
+            out.push_back('\\');
+            out.push_back((char)c);
+        }
+        else if (c >= 0x20 && c < 0x7f) {
+            out.push_back((char)c);
+        }
+        else {
+            uint32_t units[2] = { c, 0 };
+            int unit_count = 1;
+            if (c > 0xffff) {
+                c -= 0x10000;
+                units[0] = 0xd800 + (c >> 10);
+                units[1] = 0xdc00 + (c & 0x3ff);
+                unit_count = 2;
+            }
+            for (int u = 0; u < unit_count; ++u) {
+                out += "\\u";
+                for (int shift = 12; shift >= 0; shift -= 4) {
+                    out.push_back(hex_digits[(units[u] >> shift) & 0xf]);
+                }
+            }
+        }
+    }
+    out.push_back('"');
+}
+
+string SaoFU::stats_to_json(const vector<StatementSnapshot>& stats) {
+    static const char* phase_names[] = { "prepare", "execute", "describe", "fetch" };
+
+    ostringstream os;
+    os << "[";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const StatementSnapshot& s = stats[i];
+        string statement;
+        append_json_string(statement, s.statement);
+
+        if (i > 0) os << ",";
+        os << "\n  {\"statement\":" << statement
+            << ",\"executions\":" << s.executions
+            << ",\"rows\":" << s.rows
+            << ",\"bytes\":" << s.bytes
+            << ",\"refetches\":" << s.refetches
+            << ",\"exceptions\":" << s.exceptions;
+
+        for (int p = 0; p < (int)QueryPhase::Count; ++p) {
+            const HistogramSnapshot& h = s.phases[p];
+            os << ",\"" << phase_names[p] << "\":{"
+                << "\"count\":" << h.count
+                << ",\"mean_ns\":" << (uint64_t)h.mean_ns()
+                << ",\"p50_ns\":" << h.percentile_ns(50)
+                << ",\"p99_ns\":" << h.percentile_ns(99)
+                << ",\"max_ns\":" << h.max_ns << "}";
+        }
+        os << "}";
+    }
+    os << "\n]\n";
+    return os.str();
+}
+
+void JsonFileExporter::export_stats(const vector<StatementSnapshot>& stats) {
+    ofstream file(path, ios::binary | ios::trunc);
+    file << stats_to_json(stats);
+}
+
+PeriodicStatsExporter::PeriodicStatsExporter(shared_ptr<StatsExporter> exporter, chrono::milliseconds interval)
+    : exporter(move(exporter)), interval(interval) {
+    worker = thread([this] {
+        unique_lock<std::mutex> lock(mutex);
+        while (!cv.wait_for(lock, this->interval, [this] { return stopping; })) {
+            lock.unlock();
+            this->exporter->export_stats(QueryStats::instance().stats());
+            lock.lock();
+        }
+    });
+}
+
+PeriodicStatsExporter::~PeriodicStatsExporter() {
+    stop();
+}
+
+void PeriodicStatsExporter::stop() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+        // 停止時再匯出一次，確保最後的數據不會遺失
+        exporter->export_stats(QueryStats::instance().stats());
+    }
+}
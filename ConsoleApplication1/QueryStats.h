@@ -0,0 +1,205 @@
+﻿// QueryStats.h
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+// 設為 0 時所有統計程式碼都會被編譯掉（QueryTrace 變成空殼）
+#ifndef SAOFU_QUERY_STATS
+#define SAOFU_QUERY_STATS 1
+#endif
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace SaoFU {
+    enum class QueryPhase : int { Prepare = 0, Execute, Describe, Fetch, Count };
+
+    struct HistogramSnapshot {
+        std::uint64_t count = 0;
+        std::uint64_t sum_ns = 0;
+        std::uint64_t max_ns = 0;
+        std::vector<std::uint64_t> buckets;
+
+        double mean_ns() const;
+        std::uint64_t percentile_ns(double p) const;
+    };
+
+    // HDR 風格的 log-linear 直方圖：每個 2 的冪次切 8 格，誤差約 12%
+    // 只用 relaxed atomic，record() 不上鎖
+    class LatencyHistogram {
+    public:
+        static constexpr int sub_bucket_bits = 3;
+        static constexpr int bucket_count = 64 << sub_bucket_bits;
+
+        LatencyHistogram();
+
+        void record(std::uint64_t ns) noexcept;
+        HistogramSnapshot snapshot() const;
+        // 與 record() 同時進行時，那一筆可能只被清掉一部分
+        void clear() noexcept;
+
+        static int bucket_index(std::uint64_t v) noexcept;
+        static std::uint64_t bucket_lower_bound(int index) noexcept;
+    private:
+        std::array<std::atomic<std::uint64_t>, bucket_count> counts;
+        std::atomic<std::uint64_t> total_sum;
+        std::atomic<std::uint64_t> max_value;
+    };
+
+    struct StatementStats {
+        std::wstring statement;
+        LatencyHistogram phases[(int)QueryPhase::Count];
+        std::atomic<std::uint64_t> executions{ 0 };
+        std::atomic<std::uint64_t> rows{ 0 };
+        std::atomic<std::uint64_t> bytes{ 0 };
+        std::atomic<std::uint64_t> refetches{ 0 };
+        std::atomic<std::uint64_t> exceptions{ 0 };
+
+        explicit StatementStats(std::wstring s) : statement(std::move(s)) {}
+
+        void clear() noexcept;
+    };
+
+    struct StatementSnapshot {
+        std::wstring statement;
+        HistogramSnapshot phases[(int)QueryPhase::Count];
+        std::uint64_t executions;
+        std::uint64_t rows;
+        std::uint64_t bytes;
+        std::uint64_t refetches;
+        std::uint64_t exceptions;
+    };
+
+    // 把常值（'..'、N'..'、數字、0x..）換成 ?，並壓縮空白，讓同一種語句落在同一個 key
+    std::wstring normalize_statement(const std::wstring& query);
+
+    class QueryStats {
+    public:
+        // 超過此數量的不同語句全部歸到 "(other)"，避免記憶體無限成長
+        static constexpr std::size_t max_statements = 1024;
+
+        static QueryStats& instance();
+
+        StatementStats& statement(const std::wstring& query);
+        // execute_utf8() 用：以原始 UTF-8 語句快取對應的 StatementStats，同一語句只轉碼、正規化一次
+        StatementStats& statement(const std::string& utf8_query);
+        std::vector<StatementSnapshot> stats() const;
+        // 只把計數歸零，語句本身保留：QueryTrace 與 stats() 可能正在使用這些 StatementStats
+        void reset();
+    private:
+        QueryStats() = default;
+
+        mutable std::mutex mutex;
+        std::unordered_map<std::wstring, std::unique_ptr<StatementStats>> statements;
+        std::unordered_map<std::string, StatementStats*> utf8_statements;
+    };
+
+    class StatsExporter {
+    public:
+        virtual ~StatsExporter() = default;
+        virtual void export_stats(const std::vector<StatementSnapshot>& stats) = 0;
+    };
+
+    // 每次匯出都覆寫整個檔案，內容為 ASCII JSON
+    class JsonFileExporter : public StatsExporter {
+        std::wstring path;
+    public:
+        explicit JsonFileExporter(std::wstring path) : path(std::move(path)) {}
+        void export_stats(const std::vector<StatementSnapshot>& stats) override;
+    };
+
+    std::string stats_to_json(const std::vector<StatementSnapshot>& stats);
+
+    // 背景執行緒，每隔 interval 把 QueryStats::instance().stats() 交給 exporter
+    class PeriodicStatsExporter {
+    public:
+        PeriodicStatsExporter(std::shared_ptr<StatsExporter> exporter, std::chrono::milliseconds interval);
+        ~PeriodicStatsExporter();
+
+        void stop();
+
+        PeriodicStatsExporter(const PeriodicStatsExporter&) = delete;
+        PeriodicStatsExporter& operator=(const PeriodicStatsExporter&) = delete;
+    private:
+        std::shared_ptr<StatsExporter> exporter;
+        std::chrono::milliseconds interval;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stopping = false;
+        std::thread worker;
+    };
+
+#if SAOFU_QUERY_STATS
+    // 單次 command() 的量測；計數先累積在本地，finish() 時才寫入 atomic
+    class QueryTrace {
+        using clock = std::chrono::steady_clock;
+
+        StatementStats* stats;
+        clock::time_point last;
+        std::uint64_t rows = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t refetches = 0;
+        bool finished = false;
+    public:
+        explicit QueryTrace(const std::wstring& query)
+            : stats(&QueryStats::instance().statement(query)), last(clock::now()) {}
+        explicit QueryTrace(const std::string& utf8_query)
+            : stats(&QueryStats::instance().statement(utf8_query)), last(clock::now()) {}
+
+        ~QueryTrace() {
+            if (!finished) {
+                stats->exceptions.fetch_add(1, std::memory_order_relaxed);
+                flush();
+            }
+        }
+
+        // 記錄上一個 mark 到現在的耗時到指定階段
+        void mark(QueryPhase phase) {
+            auto now = clock::now();
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last).count();
+            stats->phases[(int)phase].record((std::uint64_t)ns);
+            last = now;
+        }
+
+        void add_row() { ++rows; }
+        void add_bytes(std::size_t n) { bytes += n; }
+        void add_refetch() { ++refetches; }
+
+        void finish() {
+            finished = true;
+            flush();
+        }
+
+        QueryTrace(const QueryTrace&) = delete;
+        QueryTrace& operator=(const QueryTrace&) = delete;
+    private:
+        void flush() {
+            stats->executions.fetch_add(1, std::memory_order_relaxed);
+            stats->rows.fetch_add(rows, std::memory_order_relaxed);
+            stats->bytes.fetch_add(bytes, std::memory_order_relaxed);
+            stats->refetches.fetch_add(refetches, std::memory_order_relaxed);
+        }
+    };
+#else
+    class QueryTrace {
+    public:
+        explicit QueryTrace(const std::wstring&) {}
+        explicit QueryTrace(const std::string&) {}
+        void mark(QueryPhase) {}
+        void add_row() {}
+        void add_bytes(std::size_t) {}
+        void add_refetch() {}
+        void finish() {}
+    };
+#endif
+}
+
+#endif // QUERY_STATS_H
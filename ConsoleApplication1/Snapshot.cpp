@@ -0,0 +1,365 @@
+﻿#include "Snapshot.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+using namespace SaoFU;
+using namespace std;
+
+static const char snapshot_magic[8] = { 'S', 'A', 'O', 'F', 'U', 'S', 'N', 'P' };
+
+static_assert(sizeof(SnapshotHeader) == 72, "SnapshotHeader layout changed");
+static_assert(sizeof(SnapshotColumnEntry) == 40, "SnapshotColumnEntry layout changed");
+static_assert(sizeof(wchar_t) == 2, "snapshot names and text are stored as UTF-16");
+
+namespace {
+    const uint64_t fnv_offset = 1469598103934665603ull;
+
+    uint64_t fnv1a(const void* data, size_t n, uint64_t h = fnv_offset) {
+        const BYTE* p = (const BYTE*)data;
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    uint64_t align8(uint64_t v) {
+        return (v + 7) & ~7ull;
+    }
+
+    // 依 sql_to_ctype() 取回時的定長大小，變長回傳 0
+    uint32_t fixed_width(SQLSMALLINT data_type) {
+        return (uint32_t)cell_codec(data_type).fixed_size;
+    }
+
+    class SnapshotWriter {
+        ofstream out;
+        uint64_t pos = 0;
+        uint64_t checksum = fnv_offset;
+    public:
+        explicit SnapshotWriter(const wstring& path) : out(path, ios::binary | ios::trunc) {
+            if (!out) throw runtime_error("save_snapshot: cannot open file");
+        }
+
+        void write(const void* data, size_t n) {
+            out.write((const char*)data, (streamsize)n);
+            checksum = fnv1a(data, n, checksum);
+            pos += n;
+        }
+
+        void pad() {
+            static const BYTE zeros[8] = {};
+            write(zeros, (size_t)(align8(pos) - pos));
+        }
+
+        void begin_section() { checksum = fnv_offset; }
+        uint64_t section_checksum() const { return checksum; }
+        uint64_t position() const { return pos; }
+
+        // 回頭覆寫 header / schema，不計入 checksum
+        void rewrite(uint64_t offset, const void* data, size_t n) {
+            out.seekp((streamoff)offset);
+            out.write((const char*)data, (streamsize)n);
+            out.seekp((streamoff)pos);
+        }
+
+        void close() {
+            out.close();
+            if (out.fail()) throw runtime_error("save_snapshot: write failed");
+        }
+    };
+
+    const DataCell* find_cell(const DataRow& row, const wstring& name) {
+        auto it = row.find(name);
+        return (it == row.end() || it->second.is_null()) ? nullptr : &it->second;
+    }
+}
+
+void SaoFU::save_snapshot(const wstring& path, const DataTable& table) {
+    vector<ColumnMeta> metas;
+    if (!table.empty()) {
+        for (const auto& kv : table.front()) {
+            metas.push_back(kv.second.meta);
+            metas.back().name = kv.first;
+        }
+    }
+
+    const uint64_t rows = table.size();
+    vector<SnapshotColumnEntry> entries(metas.size());
+    uint64_t schema_size = 0;
+    for (size_t c = 0; c < metas.size(); ++c) {
+        SnapshotColumnEntry& e = entries[c];
+        e = {};
+        e.data_type = metas[c].data_type;
+        e.decimal_digits = metas[c].decimal_digits;
+        e.nullable = metas[c].nullable;
+        e.name_length = (uint16_t)metas[c].name.size();
+        e.column_size = metas[c].column_size;
+
+        // 任何一列長度不符就改存變長，避免截斷
+        uint32_t width = fixed_width(e.data_type);
+        for (size_t r = 0; r < table.size() && width; ++r) {
+            const DataCell* cell = find_cell(table[r], metas[c].name);
+            if (cell && cell->buffer.size() != width) width = 0;
+        }
+        e.value_width = width;
+        schema_size += sizeof(SnapshotColumnEntry) + align8(e.name_length * sizeof(wchar_t));
+    }
+
+    SnapshotWriter w(path);
+
+    SnapshotHeader header{};
+    memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.column_count = (uint32_t)metas.size();
+    header.row_count = rows;
+    header.schema_offset = sizeof(SnapshotHeader);
+    header.schema_size = schema_size;
+    header.data_offset = header.schema_offset + schema_size;
+
+    // 先寫佔位，資料寫完才知道每欄的 offset 與 checksum
+    w.write(&header, sizeof(header));
+    vector<BYTE> schema_placeholder((size_t)schema_size);
+    w.write(schema_placeholder.data(), schema_placeholder.size());
+
+    w.begin_section();
+    const size_t words = (size_t)((rows + 63) / 64);
+    for (size_t c = 0; c < metas.size(); ++c) {
+        SnapshotColumnEntry& e = entries[c];
+        const wstring& name = metas[c].name;
+        e.block_offset = w.position();
+
+        vector<uint64_t> validity(words, 0);
+        for (size_t r = 0; r < rows; ++r) {
+            if (find_cell(table[r], name)) validity[r >> 6] |= 1ull << (r & 63);
+        }
+        w.write(validity.data(), validity.size() * sizeof(uint64_t));
+
+        if (e.value_width) {
+            vector<BYTE> zeros(e.value_width, 0);
+            for (size_t r = 0; r < rows; ++r) {
+                const DataCell* cell = find_cell(table[r], name);
+                w.write(cell ? cell->buffer.data() : zeros.data(), e.value_width);
+            }
+        }
+        else {
+            vector<uint64_t> offsets(rows + 1, 0);
+            for (size_t r = 0; r < rows; ++r) {
+                const DataCell* cell = find_cell(table[r], name);
+                offsets[r + 1] = offsets[r] + (cell ? cell->buffer.size() : 0);
+            }
+            w.write(offsets.data(), offsets.size() * sizeof(uint64_t));
+            for (size_t r = 0; r < rows; ++r) {
+                const DataCell* cell = find_cell(table[r], name);
+                if (cell && !cell->buffer.empty()) w.write(cell->buffer.data(), cell->buffer.size());
+            }
+        }
+        w.pad();
+        e.block_size = w.position() - e.block_offset;
+    }
+    header.data_size = w.position() - header.data_offset;
+    header.data_checksum = w.section_checksum();
+
+    vector<BYTE> schema;
+    schema.reserve((size_t)schema_size);
+    for (size_t c = 0; c < metas.size(); ++c) {
+        const BYTE* p = (const BYTE*)&entries[c];
+        schema.insert(schema.end(), p, p + sizeof(SnapshotColumnEntry));
+        const BYTE* n = (const BYTE*)metas[c].name.data();
+        schema.insert(schema.end(), n, n + metas[c].name.size() * sizeof(wchar_t));
+        schema.resize((size_t)align8(schema.size()), 0);
+    }
+    header.schema_checksum = fnv1a(schema.data(), schema.size());
+
+    w.rewrite(header.schema_offset, schema.data(), schema.size());
+    w.rewrite(0, &header, sizeof(header));
+    w.close();
+}
+
+unique_ptr<SnapshotView> SnapshotView::open(const wstring& path, bool verify_checksum) {
+    unique_ptr<SnapshotView> view(new SnapshotView());
+
+    view->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (view->file == INVALID_HANDLE_VALUE) {
+        throw runtime_error("SnapshotView: cannot open file");
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(view->file, &size) || (uint64_t)size.QuadPart < sizeof(SnapshotHeader)) {
+        throw runtime_error("SnapshotView: file too small");
+    }
+    view->file_size = (uint64_t)size.QuadPart;
+
+    view->mapping = CreateFileMappingW(view->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!view->mapping) {
+        throw runtime_error("SnapshotView: CreateFileMapping failed");
+    }
+    view->base = (const BYTE*)MapViewOfFile(view->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view->base) {
+        throw runtime_error("SnapshotView: MapViewOfFile failed");
+    }
+
+    const SnapshotHeader& header = *(const SnapshotHeader*)view->base;
+    if (memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        throw runtime_error("SnapshotView: not a snapshot file");
+    }
+    if (header.version != snapshot_version) {
+        throw runtime_error("SnapshotView: unsupported snapshot version");
+    }
+
+    auto in_file = [&](uint64_t offset, uint64_t n) {
+        return offset <= view->file_size && n <= view->file_size - offset;
+    };
+    if (!in_file(header.schema_offset, header.schema_size) || !in_file(header.data_offset, header.data_size)) {
+        throw runtime_error("SnapshotView: truncated file");
+    }
+
+    const BYTE* schema = view->base + header.schema_offset;
+    if (fnv1a(schema, (size_t)header.schema_size) != header.schema_checksum) {
+        throw runtime_error("SnapshotView: schema checksum mismatch");
+    }
+    if (verify_checksum && fnv1a(view->base + header.data_offset, (size_t)header.data_size) != header.data_checksum) {
+        throw runtime_error("SnapshotView: data checksum mismatch");
+    }
+
+    view->rows = header.row_count;
+    const uint64_t words = (view->rows + 63) / 64;
+
+    uint64_t cursor = 0;
+    for (uint32_t c = 0; c < header.column_count; ++c) {
+        if (cursor + sizeof(SnapshotColumnEntry) > header.schema_size) {
+            throw runtime_error("SnapshotView: corrupt schema");
+        }
+        SnapshotColumnEntry e;
+        memcpy(&e, schema + cursor, sizeof(e));
+        cursor += sizeof(e);
+
+        uint64_t name_bytes = e.name_length * sizeof(wchar_t);
+        if (cursor + name_bytes > header.schema_size) {
+            throw runtime_error("SnapshotView: corrupt schema");
+        }
+
+        Column col{};
+        col.meta.name.assign((const wchar_t*)(schema + cursor), e.name_length);
+        col.meta.data_type = e.data_type;
+        col.meta.column_size = (SQLULEN)e.column_size;
+        col.meta.decimal_digits = e.decimal_digits;
+        col.meta.nullable = e.nullable;
+        col.meta.codec = cell_codec_id(e.data_type);
+        col.width = e.value_width;
+        cursor += align8(name_bytes);
+
+        // 先擋掉 row_count 大到讓下面的乘法溢位的情況
+        if (!in_file(e.block_offset, e.block_size) || view->rows > e.block_size
+            || (e.value_width && view->rows > e.block_size / e.value_width)) {
+            throw runtime_error("SnapshotView: corrupt column block");
+        }
+        uint64_t needed = words * 8 + (e.value_width ? view->rows * e.value_width : (view->rows + 1) * 8);
+        if (e.block_size < needed || (e.block_offset & 7)) {
+            throw runtime_error("SnapshotView: corrupt column block");
+        }
+
+        const BYTE* block = view->base + e.block_offset;
+        col.validity = (const uint64_t*)block;
+        if (e.value_width) {
+            col.values = block + words * 8;
+        }
+        else {
+            col.offsets = (const uint64_t*)(block + words * 8);
+            col.blob = block + words * 8 + (view->rows + 1) * 8;
+            // cell_view() 不再檢查，所以每個 offset 都要在這裡驗過；verify_checksum = false 時也一樣
+            const uint64_t blob_size = e.block_size - (words * 8 + (view->rows + 1) * 8);
+            if (col.offsets[0] != 0) {
+                throw runtime_error("SnapshotView: corrupt column offsets");
+            }
+            for (uint64_t r = 0; r < view->rows; ++r) {
+                if (col.offsets[r + 1] < col.offsets[r]) {
+                    throw runtime_error("SnapshotView: corrupt column offsets");
+                }
+            }
+            if (col.offsets[view->rows] > blob_size) {
+                throw runtime_error("SnapshotView: corrupt column offsets");
+            }
+        }
+        view->columns.push_back(move(col));
+    }
+    return view;
+}
+
+SnapshotView::~SnapshotView() {
+    if (base) UnmapViewOfFile(base);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+
+size_t SnapshotView::row_count() const {
+    return (size_t)rows;
+}
+
+size_t SnapshotView::column_count() const {
+    return columns.size();
+}
+
+const ColumnMeta& SnapshotView::column(size_t col) const {
+    return columns.at(col).meta;
+}
+
+int SnapshotView::column_index(const wstring& name) const {
+    for (size_t c = 0; c < columns.size(); ++c) {
+        if (columns[c].meta.name == name) return (int)c;
+    }
+    return -1;
+}
+
+bool SnapshotView::is_null(size_t row, size_t col) const {
+    const Column& c = columns.at(col);
+    if (row >= rows) throw out_of_range("SnapshotView: row out of range");
+    return ((c.validity[row >> 6] >> (row & 63)) & 1) == 0;
+}
+
+CellView SnapshotView::cell_view(size_t row, size_t col) const {
+    CellView v;
+    if (is_null(row, col)) return v;
+
+    const Column& c = columns[col];
+    v.null = false;
+    if (c.width) {
+        v.data = c.values + row * c.width;
+        v.size = c.width;
+    }
+    else {
+        v.data = c.blob + c.offsets[row];
+        v.size = (size_t)(c.offsets[row + 1] - c.offsets[row]);
+    }
+    return v;
+}
+
+wstring_view SnapshotView::text(size_t row, size_t col) const {
+    SQLSMALLINT type = columns.at(col).meta.data_type;
+    if (type != SQL_WCHAR && type != SQL_WVARCHAR && type != SQL_WLONGVARCHAR) {
+        throw runtime_error("SnapshotView: not a wide text column");
+    }
+    CellView v = cell_view(row, col);
+    return wstring_view((const wchar_t*)v.data, v.size / sizeof(wchar_t));
+}
+
+DataCell SnapshotView::cell(size_t row, size_t col) const {
+    CellView v = cell_view(row, col);
+    if (v.null) return DataCell({}, true, columns[col].meta);
+    return DataCell(vector<BYTE>(v.data, v.data + v.size), false, columns[col].meta);
+}
+
+DataTable SnapshotView::to_table() const {
+    DataTable table;
+    table.reserve((size_t)rows);
+    for (size_t r = 0; r < rows; ++r) {
+        DataRow row;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            row.emplace(columns[c].meta.name, cell(r, c));
+        }
+        table.emplace_back(move(row));
+    }
+    return table;
+}
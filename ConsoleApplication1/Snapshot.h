@@ -0,0 +1,111 @@
+﻿// Snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#define NOMINMAX
+#include <windows.h>
+#include <sqlext.h>
+
+#include "DataTable.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SaoFU {
+    // 檔案格式（little-endian，所有區塊 8 bytes 對齊）：
+    //   SnapshotHeader
+    //   schema：每欄一個 SnapshotColumnEntry + UTF-16 欄名
+    //   每欄一個區塊：validity bitmap（每列 1 bit）
+    //     定長型別：values[row_count]
+    //     變長型別：uint64 offsets[row_count + 1] + blob
+    // schema 與資料區各有一個 FNV-1a 64 checksum
+    constexpr std::uint32_t snapshot_version = 1;
+
+    struct SnapshotHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t column_count;
+        std::uint64_t row_count;
+        std::uint64_t schema_offset;
+        std::uint64_t schema_size;
+        std::uint64_t data_offset;
+        std::uint64_t data_size;
+        std::uint64_t schema_checksum;
+        std::uint64_t data_checksum;
+    };
+
+    struct SnapshotColumnEntry {
+        SQLSMALLINT data_type;
+        SQLSMALLINT decimal_digits;
+        SQLSMALLINT nullable;
+        std::uint16_t name_length; // UTF-16 code units
+        std::uint32_t value_width; // 0 表示變長
+        std::uint32_t reserved;
+        std::uint64_t column_size;
+        std::uint64_t block_offset;
+        std::uint64_t block_size;
+    };
+
+    struct CellView {
+        const BYTE* data = nullptr;
+        std::size_t size = 0;
+        bool null = true;
+    };
+
+    // 欄位順序取第一列 DataRow 的走訪順序；其他列缺少的欄位存成 NULL
+    // 失敗時丟 std::runtime_error
+    void save_snapshot(const std::wstring& path, const DataTable& table);
+
+    // 以 mmap 唯讀開啟；除了 schema 之外不複製任何資料，回傳的 view 在物件存活期間有效
+    class SnapshotView {
+    public:
+        static std::unique_ptr<SnapshotView> open(const std::wstring& path, bool verify_checksum = true);
+        ~SnapshotView();
+
+        std::size_t row_count() const;
+        std::size_t column_count() const;
+        const ColumnMeta& column(std::size_t col) const;
+        // 找不到時回傳 -1
+        int column_index(const std::wstring& name) const;
+
+        bool is_null(std::size_t row, std::size_t col) const;
+        CellView cell_view(std::size_t row, std::size_t col) const;
+        // 僅限 SQL_WCHAR / SQL_WVARCHAR / SQL_WLONGVARCHAR 欄
+        std::wstring_view text(std::size_t row, std::size_t col) const;
+
+        // 定長欄的連續值陣列（NULL 位置為 0），T 的大小須與欄寬相同，否則回傳 nullptr
+        template<typename T>
+        const T* values(std::size_t col) const {
+            const Column& c = columns.at(col);
+            return c.width == sizeof(T) ? (const T*)c.values : nullptr;
+        }
+
+        DataCell cell(std::size_t row, std::size_t col) const;
+        DataTable to_table() const;
+
+        SnapshotView(const SnapshotView&) = delete;
+        SnapshotView& operator=(const SnapshotView&) = delete;
+    private:
+        struct Column {
+            ColumnMeta meta;
+            std::uint32_t width;
+            const std::uint64_t* validity;
+            const BYTE* values;
+            const std::uint64_t* offsets;
+            const BYTE* blob;
+        };
+
+        SnapshotView() = default;
+
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+        const BYTE* base = nullptr;
+        std::uint64_t file_size = 0;
+        std::uint64_t rows = 0;
+        std::vector<Column> columns;
+    };
+}
+
+#endif // SNAPSHOT_H
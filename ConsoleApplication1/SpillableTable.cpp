@@ -0,0 +1,307 @@
+﻿#include "SpillableTable.h"
+
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    template<typename T>
+    void put(vector<BYTE>& out, T v) {
+        size_t pos = out.size();
+        out.resize(pos + sizeof(T));
+        memcpy(out.data() + pos, &v, sizeof(T));
+    }
+
+    template<typename T>
+    T take(const vector<BYTE>& in, size_t& pos) {
+        if (pos + sizeof(T) > in.size()) {
+            throw runtime_error("Spill file is corrupted");
+        }
+        T v;
+        memcpy(&v, in.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+}
+
+SpillableTable::SpillableTable(size_t memory_budget) : memory_budget(memory_budget) {}
+
+SpillableTable::~SpillableTable() {
+    remove_file();
+}
+
+SpillableTable::SpillableTable(SpillableTable&& other) noexcept :
+    memory_budget(other.memory_budget),
+    memory_rows(move(other.memory_rows)),
+    spill_stats(other.spill_stats),
+    spilling(other.spilling),
+    finished(other.finished),
+    schema(move(other.schema)),
+    schema_index(move(other.schema_index)),
+    path(move(other.path)),
+    out(move(other.out)),
+    pending(move(other.pending)),
+    pending_rows(other.pending_rows)
+{
+    other.path.clear(); // 暫存檔改由這邊負責刪除
+    other.spilling = false;
+    other.spill_stats = SpillStats{};
+}
+
+SpillableTable& SpillableTable::operator=(SpillableTable&& other) noexcept {
+    if (this != &other) {
+        remove_file();
+
+        memory_budget = other.memory_budget;
+        memory_rows = move(other.memory_rows);
+        spill_stats = other.spill_stats;
+        spilling = other.spilling;
+        finished = other.finished;
+        schema = move(other.schema);
+        schema_index = move(other.schema_index);
+        path = move(other.path);
+        out = move(other.out);
+        pending = move(other.pending);
+        pending_rows = other.pending_rows;
+
+        other.path.clear();
+        other.spilling = false;
+        other.spill_stats = SpillStats{};
+    }
+    return *this;
+}
+
+void SpillableTable::remove_file() {
+    if (out.is_open()) {
+        out.close();
+    }
+    if (!path.empty()) {
+        DeleteFileW(path.c_str());
+        path.clear();
+    }
+}
+
+void SpillableTable::append(DataRow&& row) {
+    if (finished) {
+        throw logic_error("SpillableTable::append() after finish()");
+    }
+
+    if (!spilling) {
+        size_t bytes = SaoFU::memory_usage(row).total();
+        if (spill_stats.in_memory_bytes + bytes <= memory_budget) {
+            memory_rows.emplace_back(move(row));
+            spill_stats.in_memory_rows++;
+            spill_stats.in_memory_bytes += bytes;
+            return;
+        }
+        // 超過預算後一律寫檔，維持列的順序
+        spilling = true;
+        open_spill_file();
+    }
+
+    auto start = chrono::steady_clock::now();
+    spill(row);
+    spill_stats.spill_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+void SpillableTable::finish() {
+    if (finished) return;
+    finished = true;
+
+    if (spilling) {
+        auto start = chrono::steady_clock::now();
+        flush_block();
+        out.close();
+        spill_stats.spill_seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (out.fail()) {
+            throw runtime_error("Failed to write spill file");
+        }
+    }
+}
+
+size_t SpillableTable::size() const {
+    return spill_stats.in_memory_rows + spill_stats.spilled_rows;
+}
+
+bool SpillableTable::spilled() const {
+    return spilling;
+}
+
+const SpillStats& SpillableTable::stats() const {
+    return spill_stats;
+}
+
+const DataTable& SpillableTable::in_memory() const {
+    return memory_rows;
+}
+
+MemoryUsage SpillableTable::memory_usage() const {
+    MemoryUsage usage = SaoFU::memory_usage(memory_rows);
+
+    usage.metadata += heap_bytes(schema.capacity() * sizeof(ColumnMeta));
+    for (const ColumnMeta& meta : schema) {
+        usage.metadata += heap_bytes(meta.name);
+    }
+    for (const auto& kv : schema_index) {
+        usage.metadata += heap_bytes(sizeof(kv) + 2 * sizeof(void*)) + heap_bytes(kv.first);
+    }
+    usage.overhead += heap_bytes(2 * schema_index.bucket_count() * sizeof(void*));
+    usage.overhead += heap_bytes(pending.capacity());
+    return usage;
+}
+
+void SpillableTable::open_spill_file() {
+    wchar_t dir[MAX_PATH + 1] = {};
+    wchar_t name[MAX_PATH + 1] = {};
+    if (GetTempPathW(MAX_PATH + 1, dir) == 0 || GetTempFileNameW(dir, L"sfu", 0, name) == 0) {
+        throw runtime_error("Failed to create spill file");
+    }
+    path = name;
+
+    out.open(path, ios::binary | ios::trunc);
+    if (!out) {
+        remove_file();
+        throw runtime_error("Failed to open spill file");
+    }
+    pending.reserve(block_bytes + 4096);
+}
+
+uint16_t SpillableTable::column_index(const ColumnMeta& meta) {
+    auto it = schema_index.find(meta.name);
+    if (it != schema_index.end()) {
+        return it->second;
+    }
+    if (schema.size() > UINT16_MAX) {
+        throw runtime_error("Too many columns to spill");
+    }
+    uint16_t index = (uint16_t)schema.size();
+    schema.push_back(meta);
+    schema_index.emplace(meta.name, index);
+    return index;
+}
+
+void SpillableTable::spill(const DataRow& row) {
+    if (pending.empty()) {
+        put<uint32_t>(pending, 0); // payload_bytes，flush_block() 回填
+        put<uint32_t>(pending, 0); // row_count
+    }
+
+    put<uint32_t>(pending, (uint32_t)row.size());
+    for (const auto& kv : row) {
+        const DataCell& cell = kv.second;
+        put<uint16_t>(pending, column_index(cell.meta));
+        put<uint8_t>(pending, cell.null_flag ? 1 : 0);
+        put<uint32_t>(pending, (uint32_t)cell.buffer.size());
+        pending.insert(pending.end(), cell.buffer.begin(), cell.buffer.end());
+    }
+    pending_rows++;
+    spill_stats.spilled_rows++;
+
+    if (pending.size() >= block_bytes) {
+        flush_block();
+    }
+}
+
+void SpillableTable::flush_block() {
+    if (pending_rows == 0) return;
+
+    uint32_t payload = (uint32_t)(pending.size() - 2 * sizeof(uint32_t));
+    memcpy(pending.data(), &payload, sizeof(payload));
+    memcpy(pending.data() + sizeof(uint32_t), &pending_rows, sizeof(pending_rows));
+
+    out.write((const char*)pending.data(), (streamsize)pending.size());
+    if (!out) {
+        throw runtime_error("Failed to write spill file");
+    }
+    spill_stats.spilled_bytes += pending.size();
+
+    pending.clear();
+    pending_rows = 0;
+}
+
+SpillableTable::Cursor SpillableTable::cursor() const {
+    if (!finished && spilling) {
+        throw logic_error("SpillableTable::finish() must be called before reading");
+    }
+    return Cursor(*this);
+}
+
+SpillableTable::iterator SpillableTable::begin() const {
+    iterator it;
+    it.cursor = make_shared<Cursor>(cursor());
+    ++it;
+    return it;
+}
+
+SpillableTable::iterator SpillableTable::end() const {
+    return iterator();
+}
+
+SpillableTable::Cursor::Cursor(const SpillableTable& table) : table(&table) {}
+
+bool SpillableTable::Cursor::next() {
+    if (!in_file) {
+        if (memory_index < table->memory_rows.size()) {
+            current_ptr = &table->memory_rows[memory_index++];
+            return true;
+        }
+        if (table->spill_stats.spilled_rows == 0) {
+            current_ptr = nullptr;
+            return false;
+        }
+        in_file = true;
+        file.open(table->path, ios::binary);
+        if (!file) {
+            throw runtime_error("Failed to open spill file");
+        }
+    }
+
+    if (block_rows_left == 0 && !read_block()) {
+        current_ptr = nullptr;
+        return false;
+    }
+
+    uint32_t cell_count = take<uint32_t>(block, block_pos);
+    current.clear();
+    current.reserve(cell_count);
+    for (uint32_t i = 0; i < cell_count; ++i) {
+        uint16_t index = take<uint16_t>(block, block_pos);
+        bool is_null = take<uint8_t>(block, block_pos) != 0;
+        uint32_t len = take<uint32_t>(block, block_pos);
+        if (index >= table->schema.size() || block_pos + len > block.size()) {
+            throw runtime_error("Spill file is corrupted");
+        }
+
+        const ColumnMeta& meta = table->schema[index];
+        vector<BYTE> buf(block.begin() + block_pos, block.begin() + block_pos + len);
+        block_pos += len;
+        current.emplace(meta.name, DataCell(move(buf), is_null, meta));
+    }
+    block_rows_left--;
+    current_ptr = &current;
+    return true;
+}
+
+bool SpillableTable::Cursor::read_block() {
+    uint32_t header[2];
+    if (!file.read((char*)header, sizeof(header))) {
+        return false;
+    }
+    block.resize(header[0]);
+    if (!file.read((char*)block.data(), (streamsize)block.size())) {
+        throw runtime_error("Spill file is truncated");
+    }
+    block_pos = 0;
+    block_rows_left = header[1];
+    return block_rows_left > 0;
+}
+
+const DataRow& SpillableTable::Cursor::row() const {
+    if (!current_ptr) {
+        throw out_of_range("SpillableTable::Cursor has no current row");
+    }
+    return *current_ptr;
+}
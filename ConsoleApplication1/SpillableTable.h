@@ -0,0 +1,135 @@
+﻿// SpillableTable.h
+#ifndef SPILLABLE_TABLE_H
+#define SPILLABLE_TABLE_H
+
+#include "DataTable.h"
+#include "MemoryAccounting.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SaoFU {
+    struct SpillStats {
+        std::size_t in_memory_rows = 0;
+        std::size_t in_memory_bytes = 0;   // 各列 memory_usage().total() 的總和
+        std::size_t spilled_rows = 0;
+        std::uint64_t spilled_bytes = 0;   // 寫入暫存檔的位元組
+        double spill_seconds = 0;          // 序列化加寫檔的耗時
+    };
+
+    // 依序收集查詢結果；記憶體估計超過 memory_budget 後，之後的列以區塊寫入暫存檔
+    // 讀取順序與加入順序相同：先記憶體中的部分，再從暫存檔逐塊讀回
+    // 暫存檔格式（每個區塊）：
+    //   uint32 payload_bytes, uint32 row_count, 之後 row_count 列
+    //   每列：uint32 cell_count，每個 cell 為 uint16 欄位索引、uint8 null、uint32 長度、資料
+    // 欄位索引指向只存在記憶體中的 schema，ColumnMeta 不會重複寫入檔案
+    class SpillableTable {
+    public:
+        static constexpr std::size_t block_bytes = 1 << 20;
+
+        explicit SpillableTable(std::size_t memory_budget = SIZE_MAX);
+        ~SpillableTable();
+
+        SpillableTable(SpillableTable&& other) noexcept;
+        SpillableTable& operator=(SpillableTable&& other) noexcept;
+        SpillableTable(const SpillableTable&) = delete;
+        SpillableTable& operator=(const SpillableTable&) = delete;
+
+        void append(DataRow&& row);
+        // 寫出最後一個未滿的區塊並關閉暫存檔；讀取前必須呼叫（command_spill() 已處理）
+        void finish();
+
+        std::size_t size() const;
+        bool spilled() const;
+        const SpillStats& stats() const;
+        // 只含尚未溢出的前段
+        const DataTable& in_memory() const;
+        // 記憶體中的列，加上 schema 與寫檔緩衝區（計為 metadata / overhead）；不含暫存檔
+        MemoryUsage memory_usage() const;
+
+        class Cursor {
+        public:
+            bool next();
+            // 下一次 next() 之後失效
+            const DataRow& row() const;
+        private:
+            friend class SpillableTable;
+            explicit Cursor(const SpillableTable& table);
+
+            bool read_block();
+
+            const SpillableTable* table;
+            std::size_t memory_index = 0;
+            bool in_file = false;
+            std::ifstream file;
+            std::vector<BYTE> block;
+            std::size_t block_pos = 0;
+            std::uint32_t block_rows_left = 0;
+            DataRow current;
+            const DataRow* current_ptr = nullptr;
+        };
+
+        Cursor cursor() const;
+
+        template<typename F>
+        void for_each(F&& f) const {
+            Cursor c = cursor();
+            while (c.next()) {
+                f(c.row());
+            }
+        }
+
+        // 單向 input iterator，讓 range-for 可以直接使用
+        class iterator {
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = DataRow;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const DataRow*;
+            using reference = const DataRow&;
+
+            iterator() = default;
+            reference operator*() const { return cursor->row(); }
+            pointer operator->() const { return &cursor->row(); }
+            iterator& operator++() {
+                if (!cursor->next()) cursor.reset();
+                return *this;
+            }
+            bool operator==(const iterator& other) const { return cursor == other.cursor; }
+            bool operator!=(const iterator& other) const { return cursor != other.cursor; }
+        private:
+            friend class SpillableTable;
+            std::shared_ptr<Cursor> cursor;
+        };
+
+        iterator begin() const;
+        iterator end() const;
+    private:
+        std::size_t memory_budget;
+        DataTable memory_rows;
+        SpillStats spill_stats;
+        bool spilling = false;
+        bool finished = false;
+
+        std::vector<ColumnMeta> schema;
+        std::unordered_map<std::wstring, std::uint16_t> schema_index;
+
+        std::wstring path;
+        std::ofstream out;
+        std::vector<BYTE> pending;
+        std::uint32_t pending_rows = 0;
+
+        void open_spill_file();
+        void spill(const DataRow& row);
+        void flush_block();
+        std::uint16_t column_index(const ColumnMeta& meta);
+        void remove_file();
+    };
+}
+
+#endif // SPILLABLE_TABLE_H
@@ -0,0 +1,152 @@
+﻿#include "SyncedTable.h"
+
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace SaoFU;
+using namespace std;
+
+static const wchar_t key_separator = L'\x1f';
+
+SyncedTable::SyncedTable(const DatabaseAccess& db, SyncedTableOptions options) : db(db), options(move(options)) {
+    if (this->options.table.empty() || this->options.key_columns.empty() || this->options.rowversion_column.empty()) {
+        throw invalid_argument("SyncedTable requires table, key_columns and rowversion_column");
+    }
+}
+
+wstring SyncedTable::make_key(const DataRow& row) const {
+    wstring key;
+    for (size_t i = 0; i < options.key_columns.size(); ++i) {
+        if (i > 0) key.push_back(key_separator);
+        auto it = row.find(options.key_columns[i]);
+        if (it == row.end()) {
+            throw runtime_error("SyncedTable: key column missing from result");
+        }
+        key += it->second.to_string();
+    }
+    return key;
+}
+
+vector<BYTE> SyncedTable::min_active_rowversion() const {
+    DataTable result = db.command(L"SELECT MIN_ACTIVE_ROWVERSION() AS hi");
+    if (result.empty()) {
+        throw runtime_error("SyncedTable: MIN_ACTIVE_ROWVERSION() returned no rows");
+    }
+    return result.front().at(L"hi").buffer;
+}
+
+SyncStats SyncedTable::load() {
+    SyncStats stats;
+    vector<BYTE> hi = min_active_rowversion();
+
+    wstring query = L"SELECT * FROM " + options.table + L" WHERE " + options.rowversion_column + L" < @hi";
+    DataTable result = db.command(query, L"hi", hi);
+
+    keyed_rows.clear();
+    apply(move(result), stats);
+    high_water = move(hi);
+    refresh_count = 0;
+    return stats;
+}
+
+SyncStats SyncedTable::refresh() {
+    if (high_water.empty()) {
+        return load();
+    }
+
+    SyncStats stats;
+    vector<BYTE> hi = min_active_rowversion();
+
+    // 小於 hi 的交易都已結束，下次從 hi 開始即可不漏列
+    if (hi > high_water) {
+        wstring query = L"SELECT * FROM " + options.table +
+            L" WHERE " + options.rowversion_column + L" >= @lo AND " + options.rowversion_column + L" < @hi";
+        DataTable result = db.command(query, L"lo,hi", high_water, hi);
+        apply(move(result), stats);
+        high_water = move(hi);
+    }
+
+    if (options.reconcile_every > 0 && ++refresh_count >= options.reconcile_every) {
+        reconcile(stats);
+        refresh_count = 0;
+    }
+    return stats;
+}
+
+void SyncedTable::apply(DataTable&& changes, SyncStats& stats) {
+    stats.fetched_rows += changes.size();
+
+    for (DataRow& row : changes) {
+        wstring key = make_key(row);
+
+        if (!options.tombstone_column.empty()) {
+            auto it = row.find(options.tombstone_column);
+            if (it != row.end() && !it->second.is_null() && !it->second.buffer.empty() && it->second.buffer[0]) {
+                stats.deletes += keyed_rows.erase(key);
+                continue;
+            }
+        }
+
+        keyed_rows[move(key)] = move(row);
+        ++stats.upserts;
+    }
+}
+
+void SyncedTable::reconcile(SyncStats& stats) {
+    wstring columns;
+    for (size_t i = 0; i < options.key_columns.size(); ++i) {
+        if (i > 0) columns += L",";
+        columns += options.key_columns[i];
+    }
+
+    DataTable keys = db.command(L"SELECT " + columns + L" FROM " + options.table);
+
+    unordered_set<wstring> live;
+    live.reserve(keys.size());
+    for (const DataRow& row : keys) {
+        live.insert(make_key(row));
+    }
+
+    for (auto it = keyed_rows.begin(); it != keyed_rows.end();) {
+        if (live.count(it->first) == 0) {
+            it = keyed_rows.erase(it);
+            ++stats.deletes;
+        }
+        else {
+            ++it;
+        }
+    }
+    stats.reconciled = true;
+}
+
+const DataRow* SyncedTable::find(const vector<wstring>& key_values) const {
+    wstring key;
+    for (size_t i = 0; i < key_values.size(); ++i) {
+        if (i > 0) key.push_back(key_separator);
+        key += key_values[i];
+    }
+
+    auto it = keyed_rows.find(key);
+    return it == keyed_rows.end() ? nullptr : &it->second;
+}
+
+const unordered_map<wstring, DataRow>& SyncedTable::rows() const {
+    return keyed_rows;
+}
+
+DataTable SyncedTable::snapshot() const {
+    DataTable table;
+    table.reserve(keyed_rows.size());
+    for (const auto& kv : keyed_rows) {
+        table.push_back(kv.second);
+    }
+    return table;
+}
+
+const vector<BYTE>& SyncedTable::watermark() const {
+    return high_water;
+}
+
+size_t SyncedTable::size() const {
+    return keyed_rows.size();
+}
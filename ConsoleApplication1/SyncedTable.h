@@ -0,0 +1,58 @@
+﻿// SyncedTable.h
+#ifndef SYNCED_TABLE_H
+#define SYNCED_TABLE_H
+
+#include "DatabaseAccess.h"
+#include "DataTable.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SaoFU {
+    struct SyncedTableOptions {
+        std::wstring table;                     // 例如 L"event.dbo.provider"
+        std::vector<std::wstring> key_columns;  // 主鍵欄位
+        std::wstring rowversion_column;         // rowversion / timestamp 欄位
+        std::wstring tombstone_column;          // 選用：bit 欄位，為 1 時視為已刪除
+        int reconcile_every = 60;               // 每 N 次 refresh() 比對一次主鍵清單，抓實體刪除；0 表示不比對
+    };
+
+    struct SyncStats {
+        std::size_t fetched_rows = 0;
+        std::size_t upserts = 0;
+        std::size_t deletes = 0;
+        bool reconciled = false;
+    };
+
+    // 先完整載入一次，之後只抓 rowversion 落在 [上次水位, MIN_ACTIVE_ROWVERSION()) 的列
+    // 不是執行緒安全的；refresh() 與讀取須由呼叫端排程在同一條執行緒
+    class SyncedTable {
+    public:
+        SyncedTable(const DatabaseAccess& db, SyncedTableOptions options);
+
+        SyncStats load();
+        SyncStats refresh();
+
+        // key_values 依 key_columns 順序，值為 DataCell::to_string() 的結果
+        const DataRow* find(const std::vector<std::wstring>& key_values) const;
+        const std::unordered_map<std::wstring, DataRow>& rows() const;
+        DataTable snapshot() const;
+
+        const std::vector<BYTE>& watermark() const;
+        std::size_t size() const;
+    private:
+        const DatabaseAccess& db;
+        SyncedTableOptions options;
+        std::unordered_map<std::wstring, DataRow> keyed_rows;
+        std::vector<BYTE> high_water;
+        int refresh_count = 0;
+
+        std::wstring make_key(const DataRow& row) const;
+        std::vector<BYTE> min_active_rowversion() const;
+        void apply(DataTable&& changes, SyncStats& stats);
+        void reconcile(SyncStats& stats);
+    };
+}
+
+#endif // SYNCED_TABLE_H
@@ -0,0 +1,407 @@
+﻿#include "TableIndex.h"
+#include "EncodedTable.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+using namespace SaoFU;
+using namespace std;
+
+static const vector<size_t> no_rows;
+
+static const DataCell* find_cell(const DataRow& row, const wstring& column) {
+    auto it = row.find(column);
+    return it == row.end() ? nullptr : &it->second;
+}
+
+static size_t combine_hash(size_t seed, size_t h) {
+    return seed ^ (h + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+static bool make_key(const vector<const DataCell*>& cells, HashIndex::Key& key) {
+    key.cells = cells;
+    key.hash = 0;
+    for (const DataCell* c : cells) {
+        if (!c || c->is_null()) {
+            return false;
+        }
+        key.hash = combine_hash(key.hash, hash_cell(*c));
+    }
+    return true;
+}
+
+bool HashIndex::KeyEqual::operator()(const Key& a, const Key& b) const {
+    if (a.cells.size() != b.cells.size()) return false;
+    for (size_t i = 0; i < a.cells.size(); ++i) {
+        if (compare_cells(*a.cells[i], *b.cells[i]) != 0) return false;
+    }
+    return true;
+}
+
+HashIndex::HashIndex(const DataTable& table, vector<wstring> columns) : key_columns(move(columns)) {
+    buckets.reserve(table.size());
+
+    vector<const DataCell*> cells(key_columns.size());
+    for (size_t r = 0; r < table.size(); ++r) {
+        for (size_t c = 0; c < key_columns.size(); ++c) {
+            cells[c] = find_cell(table[r], key_columns[c]);
+        }
+
+        Key key;
+        if (make_key(cells, key)) {
+            buckets[move(key)].push_back(r);
+        }
+    }
+}
+
+const vector<size_t>& HashIndex::find(const vector<const DataCell*>& key_cells) const {
+    Key key;
+    if (key_cells.size() != key_columns.size() || !make_key(key_cells, key)) {
+        return no_rows;
+    }
+    auto it = buckets.find(key);
+    return it == buckets.end() ? no_rows : it->second;
+}
+
+const vector<size_t>& HashIndex::find(const vector<DataCell>& key) const {
+    vector<const DataCell*> cells;
+    cells.reserve(key.size());
+    for (const DataCell& c : key) {
+        cells.push_back(&c);
+    }
+    return find(cells);
+}
+
+const vector<size_t>& HashIndex::find(const DataRow& probe, const vector<wstring>& probe_columns) const {
+    vector<const DataCell*> cells;
+    cells.reserve(probe_columns.size());
+    for (const wstring& column : probe_columns) {
+        cells.push_back(find_cell(probe, column));
+    }
+    return find(cells);
+}
+
+const vector<wstring>& HashIndex::columns() const {
+    return key_columns;
+}
+
+size_t HashIndex::size() const {
+    return buckets.size();
+}
+
+SortedIndex::SortedIndex(const DataTable& table, wstring column) : table(table), column(move(column)) {
+    sorted_rows.reserve(table.size());
+    for (size_t r = 0; r < table.size(); ++r) {
+        const DataCell* c = find_cell(table[r], this->column);
+        if (c && !c->is_null()) {
+            sorted_rows.push_back(r);
+        }
+    }
+
+    stable_sort(sorted_rows.begin(), sorted_rows.end(), [&](size_t a, size_t b) {
+        return compare_cells(table[a].at(this->column), table[b].at(this->column)) < 0;
+    });
+}
+
+vector<size_t> SortedIndex::range(const DataCell* lo, const DataCell* hi) const {
+    auto first = sorted_rows.begin();
+    auto last = sorted_rows.end();
+
+    if (lo) {
+        first = lower_bound(sorted_rows.begin(), sorted_rows.end(), lo, [&](size_t r, const DataCell* v) {
+            return compare_cells(table[r].at(column), *v) < 0;
+        });
+    }
+    if (hi) {
+        last = upper_bound(first, sorted_rows.end(), hi, [&](const DataCell* v, size_t r) {
+            return compare_cells(*v, table[r].at(column)) < 0;
+        });
+    }
+    return first < last ? vector<size_t>(first, last) : vector<size_t>();
+}
+
+const vector<size_t>& SortedIndex::order() const {
+    return sorted_rows;
+}
+
+namespace {
+    struct AggregateState {
+        long long count = 0;
+        long long int_sum = 0;
+        double real_sum = 0;
+        bool integral = true;
+        const DataCell* extreme = nullptr;
+    };
+
+    struct Group {
+        vector<const DataCell*> keys;
+        vector<AggregateState> states;
+    };
+
+    struct GroupKeyHash {
+        size_t operator()(const vector<const DataCell*>& k) const {
+            size_t h = 0;
+            for (const DataCell* c : k) {
+                h = combine_hash(h, c ? hash_cell(*c) : 0);
+            }
+            return h;
+        }
+    };
+
+    struct GroupKeyEqual {
+        bool operator()(const vector<const DataCell*>& a, const vector<const DataCell*>& b) const {
+            for (size_t i = 0; i < a.size(); ++i) {
+                if (!a[i] || !b[i]) {
+                    if (a[i] != b[i]) return false;
+                    continue;
+                }
+                if (compare_cells(*a[i], *b[i]) != 0) return false;
+            }
+            return true;
+        }
+    };
+
+    void accumulate(AggregateState& st, const Aggregate& agg, const DataCell* cell) {
+        if (agg.kind == AggregateKind::Count) {
+            if (agg.column.empty() || (cell && !cell->is_null())) ++st.count;
+            return;
+        }
+        if (!cell || cell->is_null()) return;
+        ++st.count;
+
+        switch (agg.kind) {
+        case AggregateKind::Sum: {
+            long long i;
+            double d;
+            if (st.integral && cell_to_int64(*cell, i)) {
+                st.int_sum += i;
+            }
+            else if (cell_to_double(*cell, d)) {
+                if (st.integral) {
+                    st.real_sum = (double)st.int_sum;
+                    st.integral = false;
+                }
+                st.real_sum += d;
+            }
+            break;
+        }
+        case AggregateKind::Min:
+            if (!st.extreme || compare_cells(*cell, *st.extreme) < 0) st.extreme = cell;
+            break;
+        case AggregateKind::Max:
+            if (!st.extreme || compare_cells(*cell, *st.extreme) > 0) st.extreme = cell;
+            break;
+        default:
+            break;
+        }
+    }
+
+    DataCell finish(const AggregateState& st, const Aggregate& agg) {
+        DataCell result;
+        switch (agg.kind) {
+        case AggregateKind::Count:
+            result = make_cell((long long)st.count);
+            break;
+        case AggregateKind::Sum:
+            if (st.count == 0) {
+                result = make_cell(0LL);
+                result.null_flag = true;
+                result.buffer.clear();
+            }
+            else {
+                result = st.integral ? make_cell(st.int_sum) : make_cell(st.real_sum);
+            }
+            break;
+        default:
+            if (st.extreme) {
+                result = *st.extreme;
+            }
+            else {
+                result.null_flag = true;
+            }
+            break;
+        }
+        result.meta.name = agg.alias;
+        return result;
+    }
+}
+
+DataTable SaoFU::group_by(const DataTable& table, const vector<wstring>& keys, const vector<Aggregate>& aggregates) {
+    unordered_map<vector<const DataCell*>, size_t, GroupKeyHash, GroupKeyEqual> index;
+    vector<Group> groups;
+
+    vector<const DataCell*> key(keys.size());
+    for (const DataRow& row : table) {
+        for (size_t k = 0; k < keys.size(); ++k) {
+            const DataCell* c = find_cell(row, keys[k]);
+            key[k] = (c && !c->is_null()) ? c : nullptr;
+        }
+
+        auto it = index.find(key);
+        size_t g;
+        if (it == index.end()) {
+            g = groups.size();
+            groups.push_back({ key, vector<AggregateState>(aggregates.size()) });
+            index.emplace(key, g);
+        }
+        else {
+            g = it->second;
+        }
+
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            const DataCell* cell = aggregates[a].column.empty() ? nullptr : find_cell(row, aggregates[a].column);
+            accumulate(groups[g].states[a], aggregates[a], cell);
+        }
+    }
+
+    DataTable result;
+    result.reserve(groups.size());
+    for (const Group& group : groups) {
+        DataRow out;
+        for (size_t k = 0; k < keys.size(); ++k) {
+            if (group.keys[k]) {
+                out.emplace(keys[k], *group.keys[k]);
+            }
+            else {
+                DataCell null_cell;
+                null_cell.null_flag = true;
+                null_cell.meta.name = keys[k];
+                out.emplace(keys[k], move(null_cell));
+            }
+        }
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            out.emplace(aggregates[a].alias, finish(group.states[a], aggregates[a]));
+        }
+        result.emplace_back(move(out));
+    }
+    return result;
+}
+
+DataTable SaoFU::group_by(const EncodedTable& table, const vector<wstring>& keys, const vector<Aggregate>& aggregates) {
+    // 各 key 的 code（NULL 以 distinct() 表示）組成 mixed-radix 整數，溢位時退回 decode()
+    vector<const DictionaryColumn*> key_columns;
+    uint64_t radix = 1;
+    bool by_code = !keys.empty();
+    for (const wstring& k : keys) {
+        const DictionaryColumn* d = table.dictionary(k);
+        if (!d || radix > UINT64_MAX / (d->distinct() + 1)) {
+            by_code = false;
+            break;
+        }
+        key_columns.push_back(d);
+        radix *= d->distinct() + 1;
+    }
+    for (const Aggregate& a : aggregates) {
+        if (a.kind != AggregateKind::Count && table.is_encoded(a.column)) {
+            by_code = false;
+        }
+    }
+    if (!by_code) {
+        return group_by(table.decode(), keys, aggregates);
+    }
+
+    // 組合數不大時用直接定址，省掉雜湊
+    const size_t no_group = SIZE_MAX;
+    const bool dense = radix <= max<uint64_t>(table.size(), 1 << 16);
+    vector<size_t> slots(dense ? (size_t)radix : 0, no_group);
+    unordered_map<uint64_t, size_t> index;
+
+    vector<const DictionaryColumn*> count_columns(aggregates.size());
+    for (size_t a = 0; a < aggregates.size(); ++a) {
+        count_columns[a] = aggregates[a].column.empty() ? nullptr : table.dictionary(aggregates[a].column);
+    }
+
+    vector<uint32_t> group_codes; // 每組 keys.size() 個
+    vector<vector<AggregateState>> states;
+    for (size_t r = 0; r < table.size(); ++r) {
+        uint64_t key = 0;
+        for (const DictionaryColumn* d : key_columns) {
+            uint32_t code = d->codes[r];
+            key = key * (d->distinct() + 1) + (code == DictionaryColumn::null_code ? d->distinct() : code);
+        }
+
+        size_t* slot = nullptr;
+        if (dense) {
+            slot = &slots[(size_t)key];
+        }
+        else {
+            slot = &index.emplace(key, no_group).first->second;
+        }
+        if (*slot == no_group) {
+            *slot = states.size();
+            states.emplace_back(aggregates.size());
+            for (const DictionaryColumn* d : key_columns) {
+                group_codes.push_back(d->codes[r]);
+            }
+        }
+
+        vector<AggregateState>& group = states[*slot];
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            if (count_columns[a]) {
+                if (count_columns[a]->codes[r] != DictionaryColumn::null_code) ++group[a].count;
+                continue;
+            }
+            const DataCell* cell = aggregates[a].column.empty() ? nullptr : find_cell(table.rows()[r], aggregates[a].column);
+            accumulate(group[a], aggregates[a], cell);
+        }
+    }
+
+    DataTable result;
+    result.reserve(states.size());
+    for (size_t g = 0; g < states.size(); ++g) {
+        DataRow out;
+        for (size_t k = 0; k < keys.size(); ++k) {
+            uint32_t code = group_codes[g * keys.size() + k];
+            if (code != DictionaryColumn::null_code) {
+                out.emplace(keys[k], key_columns[k]->cell(code));
+            }
+            else {
+                DataCell null_cell;
+                null_cell.null_flag = true;
+                null_cell.meta.name = keys[k];
+                out.emplace(keys[k], move(null_cell));
+            }
+        }
+        for (size_t a = 0; a < aggregates.size(); ++a) {
+            out.emplace(aggregates[a].alias, finish(states[g][a], aggregates[a]));
+        }
+        result.emplace_back(move(out));
+    }
+    return result;
+}
+
+vector<pair<size_t, size_t>> SaoFU::hash_join(const DataTable& left, const vector<wstring>& left_keys,
+                                              const DataTable& right, const vector<wstring>& right_keys) {
+    if (left_keys.size() != right_keys.size()) {
+        throw invalid_argument("hash_join: key column count mismatch");
+    }
+
+    HashIndex index(right, right_keys);
+
+    vector<pair<size_t, size_t>> matches;
+    matches.reserve(left.size());
+    for (size_t l = 0; l < left.size(); ++l) {
+        for (size_t r : index.find(left[l], left_keys)) {
+            matches.emplace_back(l, r);
+        }
+    }
+    return matches;
+}
+
+DataTable SaoFU::inner_join(const DataTable& left, const vector<wstring>& left_keys,
+                            const DataTable& right, const vector<wstring>& right_keys) {
+    DataTable result;
+    auto matches = hash_join(left, left_keys, right, right_keys);
+    result.reserve(matches.size());
+
+    for (const auto& m : matches) {
+        DataRow row = left[m.first];
+        for (const auto& kv : right[m.second]) {
+            row.emplace(kv.first, kv.second);
+        }
+        result.emplace_back(move(row));
+    }
+    return result;
+}
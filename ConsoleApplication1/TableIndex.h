@@ -0,0 +1,87 @@
+﻿// TableIndex.h
+#ifndef TABLE_INDEX_H
+#define TABLE_INDEX_H
+
+#include "DataTable.h"
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace SaoFU {
+    class EncodedTable;
+
+    // 索引只保存指向 DataTable 內 cell 的指標與列號，建立後 table 不可再修改或釋放
+
+    // 一或多欄的 hash 索引；含 NULL 的 key 不進索引（與 SQL 等值比較相同）
+    class HashIndex {
+    public:
+        HashIndex(const DataTable& table, std::vector<std::wstring> columns);
+
+        // key 依 columns 順序
+        const std::vector<std::size_t>& find(const std::vector<const DataCell*>& key) const;
+        const std::vector<std::size_t>& find(const std::vector<DataCell>& key) const;
+        // 以 probe 列中 probe_columns 的值查詢，用於 join
+        const std::vector<std::size_t>& find(const DataRow& probe, const std::vector<std::wstring>& probe_columns) const;
+
+        const std::vector<std::wstring>& columns() const;
+        std::size_t size() const;
+
+        struct Key {
+            std::vector<const DataCell*> cells;
+            std::size_t hash;
+        };
+        struct KeyHash {
+            std::size_t operator()(const Key& k) const { return k.hash; }
+        };
+        struct KeyEqual {
+            bool operator()(const Key& a, const Key& b) const;
+        };
+    private:
+        std::vector<std::wstring> key_columns;
+        std::unordered_map<Key, std::vector<std::size_t>, KeyHash, KeyEqual> buckets;
+    };
+
+    // 單欄排序索引，用於範圍查詢；NULL 不進索引
+    class SortedIndex {
+    public:
+        SortedIndex(const DataTable& table, std::wstring column);
+
+        // 閉區間 [lo, hi]，傳 nullptr 表示該側不設限；回傳的列號依欄位值排序
+        std::vector<std::size_t> range(const DataCell* lo, const DataCell* hi) const;
+        const std::vector<std::size_t>& order() const;
+    private:
+        const DataTable& table;
+        std::wstring column;
+        std::vector<std::size_t> sorted_rows;
+    };
+
+    enum class AggregateKind { Count, Sum, Min, Max };
+
+    struct Aggregate {
+        AggregateKind kind;
+        std::wstring column; // Count 時留空代表 COUNT(*)
+        std::wstring alias;
+    };
+
+    // hash group-by；NULL 自成一組。Count 回傳 SQL_BIGINT，
+    // Sum 對整數欄回傳 SQL_BIGINT、其他數值欄回傳 SQL_DOUBLE，Min/Max 保留原欄位型別
+    DataTable group_by(const DataTable& table, const std::vector<std::wstring>& keys,
+                       const std::vector<Aggregate>& aggregates);
+    // key 全部是 dictionary 編碼欄時直接以 code 分組，結果與 DataTable 版本相同
+    // 否則（或 Sum/Min/Max 用到編碼欄）先 decode() 再交給 DataTable 版本
+    DataTable group_by(const EncodedTable& table, const std::vector<std::wstring>& keys,
+                       const std::vector<Aggregate>& aggregates);
+
+    // 以 right 建 hash，left 逐列探測；回傳 (left 列號, right 列號)
+    std::vector<std::pair<std::size_t, std::size_t>> hash_join(
+        const DataTable& left, const std::vector<std::wstring>& left_keys,
+        const DataTable& right, const std::vector<std::wstring>& right_keys);
+
+    // 合併兩邊欄位的 inner join；欄位同名時保留 left 的值
+    DataTable inner_join(const DataTable& left, const std::vector<std::wstring>& left_keys,
+                         const DataTable& right, const std::vector<std::wstring>& right_keys);
+}
+
+#endif // TABLE_INDEX_H
@@ -0,0 +1,338 @@
+﻿#include "TableSort.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <numeric>
+#include <string_view>
+#include <thread>
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    enum class SortKind { Integer, Real, WideText, Timestamp, Cells };
+
+    struct TimestampKey {
+        int64_t seconds;
+        uint32_t fraction;
+
+        bool operator<(const TimestampKey& o) const {
+            return seconds != o.seconds ? seconds < o.seconds : fraction < o.fraction;
+        }
+    };
+
+    SortKind kind_of(SQLSMALLINT data_type) {
+        switch (data_type) {
+        case SQL_BIT:
+        case SQL_TINYINT:
+        case SQL_SMALLINT:
+        case SQL_INTEGER:
+        case SQL_BIGINT:
+        case SQL_TYPE_DATE:
+        case SQL_TYPE_TIME:
+            return SortKind::Integer;
+        case SQL_REAL:
+        case SQL_FLOAT:
+        case SQL_DOUBLE:
+            return SortKind::Real;
+        case SQL_WCHAR:
+        case SQL_WVARCHAR:
+        case SQL_WLONGVARCHAR:
+            return SortKind::WideText;
+        case SQL_TYPE_TIMESTAMP:
+            return SortKind::Timestamp;
+        default:
+            // NUMERIC / DECIMAL 也走這裡，由 compare_cells() 精確比較
+            return SortKind::Cells;
+        }
+    }
+
+    template<typename T>
+    bool read_struct(const DataCell& cell, T& out) {
+        if (cell.buffer.size() < sizeof(T)) return false;
+        memcpy(&out, cell.buffer.data(), sizeof(T));
+        return true;
+    }
+
+    // 一個排序 key 抽出來的整欄值；NULL 與讀不出來的值記在 nulls
+    struct SortColumn {
+        SortKind kind = SortKind::Cells;
+        bool descending = false;
+        bool nulls_first = true;
+
+        vector<uint8_t> nulls;
+        vector<int64_t> ints;
+        vector<double> reals;
+        vector<wstring_view> texts;
+        vector<TimestampKey> stamps;
+        vector<const DataCell*> cells;
+
+        int compare(size_t a, size_t b) const {
+            if (nulls[a] || nulls[b]) {
+                if (nulls[a] && nulls[b]) return 0;
+                // NULL 的位置不受 descending 影響
+                return (nulls[a] ? -1 : 1) * (nulls_first ? 1 : -1);
+            }
+            int c = 0;
+            switch (kind) {
+            case SortKind::Integer: c = three_way(ints[a], ints[b]); break;
+            case SortKind::Real: c = compare_real(reals[a], reals[b]); break;
+            case SortKind::WideText: c = texts[a].compare(texts[b]); c = c < 0 ? -1 : (c > 0 ? 1 : 0); break;
+            case SortKind::Timestamp: c = three_way(stamps[a], stamps[b]); break;
+            case SortKind::Cells: c = compare_cells(*cells[a], *cells[b]); break;
+            }
+            return descending ? -c : c;
+        }
+    };
+
+    template<typename F>
+    void for_each_row(size_t n, F&& f) {
+        if (n >= parallel_sort_threshold) {
+            vector<size_t> rows(n);
+            iota(rows.begin(), rows.end(), size_t(0));
+            for_each(execution::par, rows.begin(), rows.end(), f);
+        }
+        else {
+            for (size_t r = 0; r < n; ++r) f(r);
+        }
+    }
+
+    SortColumn extract_column(const DataTable& table, const SortKey& key) {
+        const size_t n = table.size();
+        SortColumn col;
+        col.descending = key.descending;
+        col.nulls_first = key.nulls == NullOrder::Default ? !key.descending : key.nulls == NullOrder::First;
+
+        col.cells.resize(n);
+        col.nulls.resize(n);
+        for_each_row(n, [&](size_t r) {
+            auto it = table[r].find(key.column);
+            const DataCell* cell = it == table[r].end() ? nullptr : &it->second;
+            col.cells[r] = cell;
+            col.nulls[r] = !cell || cell->is_null();
+        });
+
+        // 整欄的比較方式只決定一次：同一種 kind 才走型別化路徑，整數與浮點混合時比 double
+        // 日期、時間與整數都歸在 Integer，但編碼不同，只有整欄同一類時才能互比
+        auto integer_family = [](SQLSMALLINT t) { return t == SQL_TYPE_DATE || t == SQL_TYPE_TIME ? t : 0; };
+        bool first = true;
+        bool mixed_family = false;
+        SQLSMALLINT family = 0;
+        for (size_t r = 0; r < n; ++r) {
+            if (col.nulls[r]) continue;
+            SQLSMALLINT t = col.cells[r]->meta.data_type;
+            SortKind k = kind_of(t);
+            if (first) {
+                col.kind = k;
+                family = integer_family(t);
+                first = false;
+                continue;
+            }
+            if (k == SortKind::Integer && integer_family(t) != family) {
+                mixed_family = true;
+            }
+            if (k != col.kind) {
+                bool numeric = (k == SortKind::Integer || k == SortKind::Real)
+                    && (col.kind == SortKind::Integer || col.kind == SortKind::Real);
+                col.kind = numeric ? SortKind::Real : SortKind::Cells;
+                if (!numeric) break;
+            }
+        }
+        if (col.kind == SortKind::Integer && mixed_family) {
+            col.kind = SortKind::Cells;
+        }
+        // 日期與時間只有在整欄同型別時才能當整數比
+        // 超過 2^53 的整數轉成 double 會失真，compare_cells() 則是精確比較，這時也改走 Cells
+        if (col.kind == SortKind::Real) {
+            for (size_t r = 0; r < n; ++r) {
+                if (col.nulls[r]) continue;
+                SQLSMALLINT t = col.cells[r]->meta.data_type;
+                long long v;
+                if (t == SQL_TYPE_DATE || t == SQL_TYPE_TIME
+                    || (cell_to_int64(*col.cells[r], v) && (v > (1LL << 53) || v < -(1LL << 53)))) {
+                    col.kind = SortKind::Cells;
+                    break;
+                }
+            }
+        }
+
+        switch (col.kind) {
+        case SortKind::Integer:
+            col.ints.resize(n);
+            for_each_row(n, [&](size_t r) {
+                if (col.nulls[r]) return;
+                const DataCell& c = *col.cells[r];
+                long long v = 0;
+                if (c.meta.data_type == SQL_TYPE_DATE) {
+                    DATE_STRUCT d;
+                    if (!read_struct(c, d)) { col.nulls[r] = 1; return; }
+                    v = ((long long)d.year * 13 + d.month) * 32 + d.day;
+                }
+                else if (c.meta.data_type == SQL_TYPE_TIME) {
+                    TIME_STRUCT t;
+                    if (!read_struct(c, t)) { col.nulls[r] = 1; return; }
+                    v = (long long)t.hour * 3600 + t.minute * 60 + t.second;
+                }
+                else if (!cell_to_int64(c, v)) {
+                    col.nulls[r] = 1;
+                    return;
+                }
+                col.ints[r] = v;
+            });
+            break;
+        case SortKind::Real:
+            col.reals.resize(n);
+            for_each_row(n, [&](size_t r) {
+                if (!col.nulls[r] && !cell_to_double(*col.cells[r], col.reals[r])) col.nulls[r] = 1;
+            });
+            break;
+        case SortKind::WideText:
+            col.texts.resize(n);
+            for_each_row(n, [&](size_t r) {
+                if (col.nulls[r]) return;
+                const DataCell& c = *col.cells[r];
+                col.texts[r] = wstring_view((const wchar_t*)c.buffer.data(), c.buffer.size() / sizeof(wchar_t));
+            });
+            break;
+        case SortKind::Timestamp:
+            col.stamps.resize(n);
+            for_each_row(n, [&](size_t r) {
+                if (col.nulls[r]) return;
+                TIMESTAMP_STRUCT t;
+                if (!read_struct(*col.cells[r], t)) { col.nulls[r] = 1; return; }
+                int64_t day = ((int64_t)t.year * 13 + t.month) * 32 + t.day;
+                col.stamps[r] = { ((day * 24 + t.hour) * 60 + t.minute) * 60 + t.second, t.fraction };
+            });
+            break;
+        case SortKind::Cells:
+            return col;
+        }
+        col.cells.clear();
+        col.cells.shrink_to_fit();
+        return col;
+    }
+
+    vector<SortColumn> extract_columns(const DataTable& table, const vector<SortKey>& keys) {
+        vector<SortColumn> columns;
+        columns.reserve(keys.size());
+        for (const SortKey& key : keys) {
+            columns.push_back(extract_column(table, key));
+        }
+        return columns;
+    }
+
+    struct RowLess {
+        const vector<SortColumn>* columns;
+
+        bool operator()(size_t a, size_t b) const {
+            for (const SortColumn& col : *columns) {
+                int c = col.compare(a, b);
+                if (c != 0) return c < 0;
+            }
+            return a < b;
+        }
+    };
+
+    DataTable copy_rows(const DataTable& table, const vector<size_t>& order) {
+        DataTable result;
+        result.reserve(order.size());
+        for (size_t r : order) {
+            result.push_back(table[r]);
+        }
+        return result;
+    }
+}
+
+vector<size_t> SaoFU::sort_order(const DataTable& table, const vector<SortKey>& keys) {
+    vector<size_t> order(table.size());
+    iota(order.begin(), order.end(), size_t(0));
+    if (keys.empty()) {
+        return order;
+    }
+
+    vector<SortColumn> columns = extract_columns(table, keys);
+    RowLess less{ &columns };
+    // 比較子最後依列號比，std::sort 的結果與 stable_sort 相同
+    if (order.size() >= parallel_sort_threshold) {
+        sort(execution::par, order.begin(), order.end(), less);
+    }
+    else {
+        sort(order.begin(), order.end(), less);
+    }
+    return order;
+}
+
+void SaoFU::sort_table(DataTable& table, const vector<SortKey>& keys) {
+    vector<size_t> order = sort_order(table, keys);
+
+    DataTable sorted;
+    sorted.reserve(table.size());
+    for (size_t r : order) {
+        sorted.emplace_back(move(table[r]));
+    }
+    table = move(sorted);
+}
+
+vector<size_t> SaoFU::top_k_order(const DataTable& table, const vector<SortKey>& keys, size_t k) {
+    const size_t n = table.size();
+    k = min(k, n);
+    if (k == 0) {
+        return {};
+    }
+    if (keys.empty()) {
+        vector<size_t> order(k);
+        iota(order.begin(), order.end(), size_t(0));
+        return order;
+    }
+
+    vector<SortColumn> columns = extract_columns(table, keys);
+    RowLess less{ &columns };
+
+    // 每段各自維護一個 max-heap（堆頂是目前第 k 名），比堆頂小的列才替換進去
+    size_t chunks = 1;
+    if (n >= parallel_sort_threshold) {
+        chunks = max<size_t>(1, min<size_t>(thread::hardware_concurrency(), n / (parallel_sort_threshold / 2)));
+    }
+    vector<vector<size_t>> heaps(chunks);
+    vector<size_t> chunk_ids(chunks);
+    iota(chunk_ids.begin(), chunk_ids.end(), size_t(0));
+
+    auto scan = [&](size_t c) {
+        vector<size_t>& heap = heaps[c];
+        heap.reserve(k);
+        size_t begin = n * c / chunks;
+        size_t end = n * (c + 1) / chunks;
+        for (size_t r = begin; r < end; ++r) {
+            if (heap.size() < k) {
+                heap.push_back(r);
+                push_heap(heap.begin(), heap.end(), less);
+            }
+            else if (less(r, heap.front())) {
+                pop_heap(heap.begin(), heap.end(), less);
+                heap.back() = r;
+                push_heap(heap.begin(), heap.end(), less);
+            }
+        }
+    };
+    if (chunks > 1) {
+        for_each(execution::par, chunk_ids.begin(), chunk_ids.end(), scan);
+    }
+    else {
+        scan(0);
+    }
+
+    vector<size_t> candidates;
+    candidates.reserve(chunks * k);
+    for (const vector<size_t>& heap : heaps) {
+        candidates.insert(candidates.end(), heap.begin(), heap.end());
+    }
+    partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(), less);
+    candidates.resize(k);
+    return candidates;
+}
+
+DataTable SaoFU::top_k(const DataTable& table, const vector<SortKey>& keys, size_t k) {
+    return copy_rows(table, top_k_order(table, keys, k));
+}
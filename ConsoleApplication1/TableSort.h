@@ -0,0 +1,34 @@
+﻿// TableSort.h
+#ifndef TABLE_SORT_H
+#define TABLE_SORT_H
+
+#include "DataTable.h"
+
+#include <string>
+#include <vector>
+
+namespace SaoFU {
+    // Default 與 compare_cells() / SQL Server 相同：NULL 視為最小值（遞增時在前、遞減時在後）
+    enum class NullOrder { Default, First, Last };
+
+    struct SortKey {
+        std::wstring column;
+        bool descending = false;
+        NullOrder nulls = NullOrder::Default;
+    };
+
+    // 列數達到這個值才用 std::execution::par
+    constexpr std::size_t parallel_sort_threshold = 1 << 15;
+
+    // 每個 key 先依整欄的 data_type 決定一次比較方式並抽成連續陣列（整數、浮點、寬字元 view、時間戳記），
+    // 之後比較不再查 DataRow 或解讀 buffer；型別混雜或其他型別退回 compare_cells()
+    // 排序結果穩定：所有 key 都相等時依原本的列號
+    std::vector<std::size_t> sort_order(const DataTable& table, const std::vector<SortKey>& keys);
+    void sort_table(DataTable& table, const std::vector<SortKey>& keys);
+
+    // 只保留前 k 列：每條執行緒以大小為 k 的 heap 掃過一段，再合併；O(n log k)，不排整張表
+    std::vector<std::size_t> top_k_order(const DataTable& table, const std::vector<SortKey>& keys, std::size_t k);
+    DataTable top_k(const DataTable& table, const std::vector<SortKey>& keys, std::size_t k);
+}
+
+#endif // TABLE_SORT_H
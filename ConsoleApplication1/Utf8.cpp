@@ -0,0 +1,347 @@
+﻿#include "Utf8.h"
+
+#include "ColumnKernels.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SAOFU_X86_UTF8 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SAOFU_AVX2_TARGET
+#else
+#define SAOFU_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#else
+#define SAOFU_X86_UTF8 0
+#endif
+
+using namespace SaoFU;
+using namespace std;
+
+namespace {
+    const char32_t replacement_char = 0xFFFD;
+
+    // 只有 wchar_t 為 UTF-16 時才有對應的 SIMD 路徑
+    bool use_avx2() {
+        return sizeof(wchar_t) == 2 && active_kernel_isa() == KernelIsa::Avx2;
+    }
+
+    // 解一個 UTF-8 碼點並前進 i；過長編碼、surrogate、超出範圍或截斷都只吃一個位元組並回傳 U+FFFD
+    char32_t decode_utf8(const unsigned char* p, size_t n, size_t& i) {
+        unsigned char c = p[i];
+        if (c < 0x80) {
+            ++i;
+            return c;
+        }
+
+        int extra;
+        char32_t cp;
+        char32_t min_cp;
+        if ((c & 0xE0) == 0xC0) { extra = 1; cp = c & 0x1F; min_cp = 0x80; }
+        else if ((c & 0xF0) == 0xE0) { extra = 2; cp = c & 0x0F; min_cp = 0x800; }
+        else if ((c & 0xF8) == 0xF0) { extra = 3; cp = c & 0x07; min_cp = 0x10000; }
+        else { ++i; return replacement_char; }
+
+        if (i + extra >= n) {
+            ++i;
+            return replacement_char;
+        }
+        for (int k = 1; k <= extra; ++k) {
+            unsigned char cc = p[i + k];
+            if ((cc & 0xC0) != 0x80) {
+                ++i;
+                return replacement_char;
+            }
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        if (cp < min_cp || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+            ++i;
+            return replacement_char;
+        }
+        i += extra + 1;
+        return cp;
+    }
+
+    // 解一個寬字元碼點並前進 i；落單的 surrogate 回傳 U+FFFD
+    char32_t decode_wide(const wchar_t* p, size_t n, size_t& i) {
+        char32_t c = (char32_t)p[i++];
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (c >= 0xD800 && c <= 0xDBFF) {
+                if (i < n && (char32_t)p[i] >= 0xDC00 && (char32_t)p[i] <= 0xDFFF) {
+                    return 0x10000 + ((c - 0xD800) << 10) + ((char32_t)p[i++] - 0xDC00);
+                }
+                return replacement_char;
+            }
+            if (c >= 0xDC00 && c <= 0xDFFF) {
+                return replacement_char;
+            }
+            return c;
+        }
+        else {
+            return (c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) ? replacement_char : c;
+        }
+    }
+
+    size_t put_utf8(char* dst, char32_t cp) {
+        if (cp < 0x80) {
+            dst[0] = (char)cp;
+            return 1;
+        }
+        if (cp < 0x800) {
+            dst[0] = (char)(0xC0 | (cp >> 6));
+            dst[1] = (char)(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp < 0x10000) {
+            dst[0] = (char)(0xE0 | (cp >> 12));
+            dst[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+            dst[2] = (char)(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        dst[0] = (char)(0xF0 | (cp >> 18));
+        dst[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+        dst[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        dst[3] = (char)(0x80 | (cp & 0x3F));
+        return 4;
+    }
+
+    size_t put_wide(wchar_t* dst, char32_t cp) {
+        if constexpr (sizeof(wchar_t) == 2) {
+            if (cp >= 0x10000) {
+                cp -= 0x10000;
+                dst[0] = (wchar_t)(0xD800 + (cp >> 10));
+                dst[1] = (wchar_t)(0xDC00 + (cp & 0x3FF));
+                return 2;
+            }
+        }
+        dst[0] = (wchar_t)cp;
+        return 1;
+    }
+
+#if SAOFU_X86_UTF8
+    // 以下三個函式都在遇到第一個含非 ASCII 的 32 字元區塊時停下，回傳已處理的長度
+
+    SAOFU_AVX2_TARGET size_t ascii_prefix_avx2(const char* src, size_t n) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+            if (_mm256_movemask_epi8(v) != 0) break;
+        }
+        return i;
+    }
+
+    SAOFU_AVX2_TARGET size_t ascii_utf8_to_wide_avx2(const char* src, size_t n, wchar_t* dst) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+            if (_mm256_movemask_epi8(v) != 0) break;
+            __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+            __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+            _mm256_storeu_si256((__m256i*)(dst + i), lo);
+            _mm256_storeu_si256((__m256i*)(dst + i + 16), hi);
+        }
+        return i;
+    }
+
+    SAOFU_AVX2_TARGET size_t ascii_wide_to_utf8_avx2(const wchar_t* src, size_t n, char* dst) {
+        const __m256i non_ascii = _mm256_set1_epi16((short)0xFF80);
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+            if (!_mm256_testz_si256(_mm256_or_si256(a, b), non_ascii)) break;
+            // packus 以 128-bit lane 為單位交錯，permute 把 a、b 的順序排回來
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+            _mm256_storeu_si256((__m256i*)(dst + i), packed);
+        }
+        return i;
+    }
+#endif
+}
+
+bool SaoFU::is_ascii(string_view s) {
+    size_t i = 0;
+#if SAOFU_X86_UTF8
+    if (use_avx2()) {
+        i = ascii_prefix_avx2(s.data(), s.size());
+    }
+#endif
+    for (; i < s.size(); ++i) {
+        if ((unsigned char)s[i] >= 0x80) return false;
+    }
+    return true;
+}
+
+void SaoFU::utf8_to_wide(string_view s, wstring& out) {
+    // 每個 UTF-8 位元組最多產生一個 UTF-16 code unit，先配到上限再縮回
+    const size_t base = out.size();
+    out.resize(base + s.size());
+    wchar_t* dst = &out[base];
+
+    const unsigned char* p = (const unsigned char*)s.data();
+    const size_t n = s.size();
+    const bool simd = use_avx2();
+    size_t i = 0;
+    size_t w = 0;
+
+    while (i < n) {
+#if SAOFU_X86_UTF8
+        if (simd && n - i >= 32) {
+            size_t done = ascii_utf8_to_wide_avx2(s.data() + i, n - i, dst + w);
+            i += done;
+            w += done;
+            // 含非 ASCII 的區塊（或不足 32 的尾端）逐碼點處理完再回到 SIMD
+            size_t stop = min(n, i + 32);
+            while (i < stop) {
+                w += put_wide(dst + w, decode_utf8(p, n, i));
+            }
+            continue;
+        }
+#endif
+        if (p[i] < 0x80) {
+            dst[w++] = (wchar_t)p[i++];
+        }
+        else {
+            w += put_wide(dst + w, decode_utf8(p, n, i));
+        }
+    }
+    out.resize(base + w);
+}
+
+void SaoFU::wide_to_utf8(wstring_view s, string& out) {
+    // 上限是每個 code unit 4 個位元組，先寫到暫存區，out 只配置實際長度
+    thread_local string scratch;
+    if (scratch.size() < s.size() * 4) {
+        scratch.resize(s.size() * 4);
+    }
+    char* dst = &scratch[0];
+
+    const wchar_t* p = s.data();
+    const size_t n = s.size();
+    const bool simd = use_avx2();
+    size_t i = 0;
+    size_t w = 0;
+
+    while (i < n) {
+#if SAOFU_X86_UTF8
+        if (simd && n - i >= 32) {
+            size_t done = ascii_wide_to_utf8_avx2(p + i, n - i, dst + w);
+            i += done;
+            w += done;
+            size_t stop = min(n, i + 32);
+            while (i < stop) {
+                w += put_utf8(dst + w, decode_wide(p, n, i));
+            }
+            continue;
+        }
+#endif
+        if ((unsigned)p[i] < 0x80) {
+            dst[w++] = (char)p[i++];
+        }
+        else {
+            w += put_utf8(dst + w, decode_wide(p, n, i));
+        }
+    }
+    out.append(dst, w);
+}
+
+string SaoFU::wide_to_utf8(wstring_view s) {
+    string out;
+    wide_to_utf8(s, out);
+    return out;
+}
+
+wstring SaoFU::utf8_to_wide(string_view s) {
+    wstring out;
+    utf8_to_wide(s, out);
+    return out;
+}
+
+bool SaoFU::is_text_type(SQLSMALLINT data_type) {
+    switch (data_type) {
+    case SQL_CHAR:
+    case SQL_VARCHAR:
+    case SQL_LONGVARCHAR:
+    case SQL_WCHAR:
+    case SQL_WVARCHAR:
+    case SQL_WLONGVARCHAR:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Utf8Cell::is_text() const {
+    return is_text_type(data_type);
+}
+
+string_view Utf8Cell::text() const {
+    if (!is_text()) {
+        throw logic_error("Utf8Cell::text() on a non-text column");
+    }
+    return data;
+}
+
+string Utf8Cell::to_string() const {
+    if (null_flag || data.empty()) return "(NULL)";
+    if (is_text()) return data;
+
+    ColumnMeta meta{ L"", data_type, 0, 0, SQL_NULLABLE };
+    DataCell cell(vector<BYTE>(data.begin(), data.end()), false, meta);
+    return wide_to_utf8(cell.to_string());
+}
+
+Utf8Table SaoFU::to_utf8_table(const DataTable& table) {
+    Utf8Table result;
+    result.reserve(table.size());
+
+    unordered_map<wstring, string> names;
+    wstring acp_text;
+    for (const DataRow& row : table) {
+        Utf8Row out;
+        out.reserve(row.size());
+        for (const auto& kv : row) {
+            const DataCell& cell = kv.second;
+            Utf8Cell u;
+            u.data_type = cell.meta.data_type;
+            u.null_flag = cell.null_flag;
+
+            if (!cell.null_flag) {
+                switch (cell.meta.data_type) {
+                case SQL_WCHAR:
+                case SQL_WVARCHAR:
+                case SQL_WLONGVARCHAR:
+                    wide_to_utf8(wstring_view((const wchar_t*)cell.buffer.data(), cell.buffer.size() / sizeof(wchar_t)), u.data);
+                    break;
+                case SQL_CHAR:
+                case SQL_VARCHAR:
+                case SQL_LONGVARCHAR: {
+                    string_view bytes((const char*)cell.buffer.data(), cell.buffer.size());
+                    if (GetACP() == CP_UTF8 || is_ascii(bytes)) {
+                        u.data.assign(bytes);
+                        break;
+                    }
+                    int n = MultiByteToWideChar(CP_ACP, 0, bytes.data(), (int)bytes.size(), nullptr, 0);
+                    acp_text.resize((size_t)max(n, 0));
+                    MultiByteToWideChar(CP_ACP, 0, bytes.data(), (int)bytes.size(), &acp_text[0], n);
+                    wide_to_utf8(acp_text, u.data);
+                    break;
+                }
+                default:
+                    u.data.assign((const char*)cell.buffer.data(), cell.buffer.size());
+                    break;
+                }
+            }
+
+            auto name = names.find(kv.first);
+            if (name == names.end()) {
+                name = names.emplace(kv.first, wide_to_utf8(kv.first)).first;
+            }
+            out.emplace(name->second, move(u));
+        }
+        result.emplace_back(move(out));
+    }
+    return result;
+}
@@ -0,0 +1,58 @@
+﻿// Utf8.h
+#ifndef SAOFU_UTF8_H
+#define SAOFU_UTF8_H
+
+#include "DataTable.h"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace SaoFU {
+    // UTF-8 <-> wchar_t（Windows 為 UTF-16，其他平台為 UTF-32）
+    // 純 ASCII 的區段走 AVX2 一次處理 32 個字元，其餘逐碼點；不合法的序列換成 U+FFFD
+    // 是否使用 AVX2 跟著 active_kernel_isa()，force_kernel_isa(Scalar) 可強制走純量版本
+    std::string wide_to_utf8(std::wstring_view s);
+    std::wstring utf8_to_wide(std::string_view s);
+    void wide_to_utf8(std::wstring_view s, std::string& out);   // 附加到 out 後面
+    void utf8_to_wide(std::string_view s, std::wstring& out);
+
+    bool is_ascii(std::string_view s);
+
+    // SQL_CHAR / SQL_WCHAR 系列
+    bool is_text_type(SQLSMALLINT data_type);
+
+    inline std::u8string_view as_u8(std::string_view s) {
+        return std::u8string_view((const char8_t*)s.data(), s.size());
+    }
+    inline std::string_view from_u8(std::u8string_view s) {
+        return std::string_view((const char*)s.data(), s.size());
+    }
+
+    // command_utf8() 的結果；文字欄（CHAR/WCHAR 系列）一律存 UTF-8，其他型別存 SQL_C_* 的原始位元組
+    // 欄位資訊不像 DataCell 那樣每格複製一份 ColumnMeta，只留 data_type
+    struct Utf8Cell {
+        std::string data;
+        bool null_flag = false;
+        SQLSMALLINT data_type = 0;
+
+        bool is_null() const { return null_flag; }
+        bool is_text() const;
+
+        // 文字欄直接回傳 data 的 view，不做轉碼；非文字欄丟 std::logic_error
+        std::string_view text() const;
+        std::u8string_view u8text() const { return as_u8(text()); }
+
+        // 非文字欄依 DataCell::to_string() 的格式輸出，再轉成 UTF-8
+        std::string to_string() const;
+    };
+
+    using Utf8Row = std::unordered_map<std::string, Utf8Cell>;
+    using Utf8Table = std::vector<Utf8Row>;
+
+    // 文字欄轉成 UTF-8（SQL_CHAR 視為 ACP 編碼），其他欄位原樣複製
+    Utf8Table to_utf8_table(const DataTable& table);
+}
+
+#endif // SAOFU_UTF8_H